@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Palette.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace color
+{
+
+// Which bins of a 16x16x16 quantization of the RGB cube a set of colors
+// falls in, as a 4096-bit set. Filling it is O(n), growing every bin into
+// its 26 neighbors is a few shifts per word and counting is a popcount.
+class ColorCoverage
+{
+public:
+   static const size_t AXIS_BITS = 4;
+   static const size_t AXIS = size_t(1) << AXIS_BITS;
+   static const size_t BINS = AXIS * AXIS * AXIS;
+   static const size_t WORDS = BINS / 64;
+
+   ColorCoverage() { Clear(); }
+   ColorCoverage(const Color* colors, size_t count) { Assign(colors, count); }
+
+   void Clear();
+   void Assign(const Color* colors, size_t count);
+   void Add(const Color& color);
+   // Also mark every bin next to an occupied one, diagonals included
+   void Dilate();
+
+   size_t Count() const;
+   double Fraction() const { return double(Count()) / BINS; }
+
+   // Share of the cube within one bin of some color, the palette's
+   // m_ColorRepresentation
+   static double Representation(const Color* colors, size_t count);
+private:
+   // Bits run b fastest, then g, then r: a word holds four 16-bit b rows
+   // of one r slice, and an r slice spans four consecutive words
+   uint64_t m_Words[WORDS];
+};
+
+}
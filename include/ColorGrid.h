@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Palette.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace color
+{
+
+// Uniform voxel grid over the RGB cube for nearest neighbor queries. Cells
+// are power-of-two cubes sized for about one color each, and a query walks
+// outward shell by shell until no unvisited cell can hold anything closer.
+// For reasonably spread palettes that makes a query O(1) and the closest
+// pair O(n). Distances are exact squared integers.
+class ColorGrid
+{
+public:
+   static const size_t NONE = SIZE_MAX;
+
+   ColorGrid() = default;
+   explicit ColorGrid(const Palette& palette);
+   void Build(const Color* colors, size_t count);
+
+   size_t Size() const { return m_Colors.size(); }
+   // Palette index of the color closest to query, skipping the color at
+   // index exclude. NONE when there is no other color.
+   size_t Nearest(const Color& query, uint32_t* squared = nullptr, size_t exclude = NONE) const;
+   // Squared distance from every color to its nearest other color, indexed
+   // like the palette. UINT32_MAX for a lone color.
+   void NearestSquared(std::vector<uint32_t>& squared) const;
+   // Squared distance of the closest pair, UINT32_MAX with fewer than two
+   // colors. The pair's palette indices go to first and second if given.
+   uint32_t ClosestPair(size_t* first = nullptr, size_t* second = nullptr) const;
+private:
+   int m_Cells = 1;
+   int m_Shift = 8;
+   // Colors grouped by cell, cell c holds [m_CellStart[c], m_CellStart[c + 1])
+   std::vector<uint32_t> m_CellStart;
+   std::vector<Color> m_Colors;
+   std::vector<uint32_t> m_Indices;
+private:
+   size_t Cell(int x, int y, int z) const { return (size_t(x) * m_Cells + y) * m_Cells + z; }
+   // Lowers bestSquared and sets bestIndex on anything strictly closer
+   void Search(const Color& query, size_t exclude, uint32_t& bestSquared, size_t& bestIndex) const;
+};
+
+}
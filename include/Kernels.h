@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cfloat>
+
+// SSE2 is part of the x86-64 baseline, AVX2 is picked at runtime
+#if defined(__x86_64__) || defined(_M_X64)
+#define COLOR_SIMD_X86 1
+#endif
+
+#if defined(COLOR_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define COLOR_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define COLOR_TARGET_AVX2
+#endif
+
+namespace color
+{
+namespace kernels
+{
+
+// True when the CPU and OS support AVX2 (checked once)
+bool HasAvx2();
+
+// Encode linear values to 8-bit sRGB channels, clamped like SrgbTables::Encode
+void Encode(const double* linear, unsigned char* channels, size_t count);
+
+// Pick each 4-byte color from first where its bit in bits (64 colors per
+// word, lowest bit first) is set, from second where it is clear
+void SelectColors(const unsigned char* first, const unsigned char* second, const uint64_t* bits,
+                  unsigned char* out, size_t colors);
+
+// Per byte (first * (256 - weight) + second * weight + 128) >> 8, weight 0-256
+void BlendBytes(const unsigned char* first, const unsigned char* second, unsigned weight,
+                unsigned char* out, size_t count);
+
+// Add a signed delta to every byte, saturating at 0 and 255
+void AddSaturated(unsigned char* bytes, const signed char* deltas, size_t count);
+
+// Running statistics over pairwise color distances. Min and max are kept
+// squared so only the sum needs a square root per pair. They are double like
+// the sum, so perceptual distances keep their precision; the RGB kernels
+// compare in float lanes, where 8-bit squared distances are exact.
+struct PairStats
+{
+   double m_Sum = 0.0;
+   double m_MinSquared = DBL_MAX;
+   double m_MaxSquared = 0.0;
+   size_t m_Pairs = 0;
+
+   void Merge(const PairStats& other)
+   {
+      m_Sum += other.m_Sum;
+      m_MinSquared = other.m_MinSquared < m_MinSquared ? other.m_MinSquared : m_MinSquared;
+      m_MaxSquared = other.m_MaxSquared > m_MaxSquared ? other.m_MaxSquared : m_MaxSquared;
+      m_Pairs += other.m_Pairs;
+   }
+};
+
+// Accumulate the distances of pairs (i, j) with i in [rowBegin, rowEnd) and
+// j in [max(columnBegin, i + 1), columnEnd), over structure-of-arrays 0-255
+// channels. The sum is added in row-major pair order, the same order as a
+// plain double loop, so it matches one bit for bit.
+void PairDistances(const float* r, const float* g, const float* b,
+                   size_t rowBegin, size_t rowEnd, size_t columnBegin, size_t columnEnd, PairStats& stats);
+
+}
+}
@@ -1,58 +1,72 @@
 #pragma once
 
 #include <vector>
+#include <memory>
 #include <unordered_map>
+#include <cstdint>
 #include <cmath>
 #include <string>
 #include <iostream>
+#include <algorithm>
+
+#include "Srgb.h"
+#include "Kernels.h"
+#include "ThreadPool.h"
+#include "Random.h"
 
 namespace color
 {
 
 static const size_t VULCAN_PALETTE_SIZE = 256;
 
-static const double PROTANOPIA_MATRIX[9] = 
+static constexpr double PROTANOPIA_MATRIX[9] = 
 {
    0.567, 0.433, 0.0,
    0.558, 0.442, 0.0,
    0.0, 0.242, 0.758
 };
-static const double DEUTERANOPIA_MATRIX[9] = 
+static constexpr double DEUTERANOPIA_MATRIX[9] = 
 {
    0.625, 0.375, 0.0,
    0.7, 0.3, 0.0,
    0.0, 0.3, 0.7
 };
-const double TRITANOPIA_MATRIX[9] = 
+constexpr double TRITANOPIA_MATRIX[9] = 
 {
    0.95, 0.05, 0.0,
    0.0, 0.433, 0.567,
    0.0, 0.475, 0.525
 };
-const double PROTANOMALY_MATRIX[9] = 
+constexpr double PROTANOMALY_MATRIX[9] = 
 {
    0.817, 0.183, 0.0,
    0.333, 0.667, 0.0,
    0.0, 0.125, 0.875
 };
-const double DEUTERANOMALY_MATRIX[9] = 
+constexpr double DEUTERANOMALY_MATRIX[9] = 
 {
    0.8, 0.2, 0.0,
    0.258, 0.742, 0.0,
    0.0, 0.142, 0.858
 };
-const double TRITANOMALY_MATRIX[9] = 
+constexpr double TRITANOMALY_MATRIX[9] = 
 {
    0.967, 0.033, 0.0,
    0.0, 0.733, 0.267,
    0.0, 0.183, 0.817
 };
-const double TRISTIMULUS_MATRIX[9] = 
+constexpr double TRISTIMULUS_MATRIX[9] = 
 {
    3.2406, -1.5372, -0.4986,
    -0.9689, 1.8758, 0.0415,
    0.0557, -0.2040, 1.0570
 };
+constexpr double IDENTITY_MATRIX[9] =
+{
+   1.0, 0.0, 0.0,
+   0.0, 1.0, 0.0,
+   0.0, 0.0, 1.0
+};
 
 enum BlindnessType : size_t
 {
@@ -71,25 +85,76 @@ const std::unordered_map<BlindnessType, std::string> BlindnessTypeNames = {
    {BlindnessType::LAST, "Last"}
 };
 
-struct Color
+// How Palette::Evaluate measures the distance between two colors. RGB is
+// Euclidean on the 8-bit channels, the rest are perceptual (see Perceptual.h).
+enum DistanceMetric : size_t
+{
+   RGB, CIE76, CIE2000, OKLAB, LAST_METRIC
+};
+
+const std::unordered_map<DistanceMetric, std::string> DistanceMetricNames = {
+   {DistanceMetric::RGB, "RGB"},
+   {DistanceMetric::CIE76, "CIE76"},
+   {DistanceMetric::CIE2000, "CIEDE2000"},
+   {DistanceMetric::OKLAB, "Oklab"},
+   {DistanceMetric::LAST_METRIC, "Last"}
+};
+
+// 8-bit channels packed into 4 bytes, pad always 0. Batches are worked on
+// as raw bytes by the kernels; shifts saturate in kernels::AddSaturated.
+struct alignas(4) Color
 {
-   Color() : r(0), g(0), b(0) {}
-   Color(size_t r, size_t g, size_t b) : r(r), g(g), b(b) {}
+   Color() : r(0), g(0), b(0), pad(0) {}
+   Color(uint8_t r, uint8_t g, uint8_t b) : r(r), g(g), b(b), pad(0) {}
    double Distance(const Color& other) const;
    void Print() const;
-   size_t r, g, b;
+   bool operator==(const Color& other) const { return r == other.r && g == other.g && b == other.b; }
+   bool operator!=(const Color& other) const { return !(*this == other); }
+   uint8_t r, g, b;
+   uint8_t pad;
 };
+static_assert(sizeof(Color) == 4, "Color is meant to pack into 32 bits");
+
+struct MultiTypeEvaluation;
 
 struct Palette
 {
    Palette(const std::string& name) : m_Name(name) {};
-   void AddColor(const Color& color) { m_Colors.push_back(color); };
+   void AddColor(const Color& color);
+   // Replaces one color. With incremental evaluation enabled this also
+   // updates m_Evaluation against the other n - 1 colors.
+   void SetColor(size_t index, const Color& color);
+   // Replaces count colors at once, scoring once at the end. Past a quarter
+   // of the palette this falls back to a full Evaluate.
+   void SetColors(const size_t* indices, const Color* colors, size_t count);
    void Print(bool colors = false) const;
+   // Large palettes are evaluated in parallel on the given pool. The result
+   // depends only on the colors, bit for bit, not on the thread count or
+   // the SIMD width picked at runtime.
    void Evaluate();
+   void Evaluate(ThreadPool& pool);
+   // Scores this palette as seen under every BlindnessType in one fused
+   // pass, converting from these colors. Each type's result matches
+   // converting and calling Evaluate, bit for bit.
+   void EvaluateAllTypes(MultiTypeEvaluation& evaluation) const;
+   void EvaluateAllTypes(MultiTypeEvaluation& evaluation, ThreadPool& pool) const;
+   // Closest pair distance and every color's distance to its nearest other
+   // color, found through a ColorGrid rather than all pairs. Always RGB and
+   // unnormalized, same scale as Color::Distance.
+   double MinDistance() const;
+   void NearestDistances(std::vector<double>& distances) const;
+   // Keep every pairwise distance around so AddColor and SetColor can update
+   // m_Evaluation without a full Evaluate. Colors must then only change
+   // through those two, or Evaluate has to be called again to resync.
+   // Only the RGB metric is tracked this way.
+   void EnableIncrementalEvaluation();
+   void DisableIncrementalEvaluation();
+   bool IsIncremental() const { return m_Distances.m_Enabled && m_Metric == DistanceMetric::RGB; }
    void Draw() const;
    void AppendToDrawing(size_t offsetX, size_t offsetY) const;
    std::vector<Color> m_Colors;
    std::string m_Name;
+   DistanceMetric m_Metric = DistanceMetric::RGB;
    struct PaletteEvaluation
    {
       PaletteEvaluation()
@@ -114,11 +179,99 @@ struct Palette
    };
 
    PaletteEvaluation m_Evaluation;
+
+   // Scores equally sized color sets stored back to back, such as one
+   // palette converted for several types, with the same fused pair pass.
+   // Each result matches Evaluate on a palette holding that set.
+   static void EvaluateSets(const Color* colors, size_t sets, size_t paletteSize, DistanceMetric metric,
+                            PaletteEvaluation* evaluations, ThreadPool& pool);
+private:
+   // Squared distances fit in 18 bits, stored as the lower triangle so a new
+   // color appends its row: pair (i, j < i) lives at i * (i - 1) / 2 + j.
+   // The sum is compensated since it only ever gets deltas.
+   struct DistanceState
+   {
+      std::vector<uint32_t> m_Squared;
+      double m_Sum = 0;
+      double m_Compensation = 0;
+      uint32_t m_MinSquared = 0;
+      uint32_t m_MaxSquared = 0;
+      size_t m_MinCount = 0;
+      size_t m_MaxCount = 0;
+      bool m_Enabled = false;
+
+      void Add(uint32_t squared);
+      // False once the last pair at the minimum or maximum is gone
+      bool Remove(uint32_t squared);
+      void AddToSum(double value);
+      double Sum() const { return m_Sum + m_Compensation; }
+   };
+   DistanceState m_Distances;
+
+   void BuildDistances(double sumDistance);
+   void RescanDistances();
+   // Reprices the pairs of m_Colors[index] after it changed, without scoring.
+   // False when the minimum or maximum needs a RescanDistances.
+   bool UpdateDistances(size_t index);
+   void SetEvaluation(double sumDistance, double minSquared, double maxSquared);
+   static void Score(PaletteEvaluation& evaluation, const Color* colors, size_t paletteSize, DistanceMetric metric,
+                     double sumDistance, double minSquared, double maxSquared);
+};
+
+struct MultiTypeEvaluation
+{
+   void Print() const;
+   // Indexed by BlindnessType
+   Palette::PaletteEvaluation m_Types[BlindnessType::LAST];
+   // Every field's lowest value across the types, the total included, so
+   // the palette scores no better than under its hardest type
+   Palette::PaletteEvaluation m_WorstCase;
 };
 
+class SimulationLUT;
+
 struct Converter
 {
+   using ConvertFunction = Color (*)(const Color& color);
+   using ConvertColorsFunction = void (*)(const Color* colors, size_t count, Color* converted);
+
    static Color ConvertColor(const Color& color, const BlindnessType& type);
+   // Batch conversion over whole palettes, converted may alias colors
+   static void ConvertPalette(const Palette& palette, const BlindnessType& type, Palette& converted);
+   static void ConvertColors(const Color* colors, size_t count, const BlindnessType& type, Color* converted);
+   // Specializations with the matrix folded in at compile time. The runtime
+   // versions above dispatch to these through a jump table, callers with a
+   // fixed type can pick one once.
+   template <BlindnessType T> static Color Convert(const Color& color);
+   template <BlindnessType T> static void ConvertColors(const Color* colors, size_t count, Color* converted);
+   // Every type in one pass, each color decoded once. converted is indexed
+   // by BlindnessType and holds one output per type up to LAST.
+   static void ConvertAllTypes(const Palette& palette, std::vector<Palette>& converted);
+   static void ConvertAllTypes(const Color* colors, size_t count, Color* const converted[]);
+   static ConvertFunction GetConvertFunction(const BlindnessType& type);
+   static ConvertColorsFunction GetConvertColorsFunction(const BlindnessType& type);
+
+   // Route every conversion above through a precomputed SimulationLUT instead
+   // of the matrix path. Call before conversions start, not while they run.
+   static const SimulationLUT& EnableSimulationLUT(size_t gridSize = 33, const std::string& cachePath = "");
+   static void DisableSimulationLUT();
+   static const SimulationLUT* GetSimulationLUT();
+   // Always the matrix path, the reference the LUT is measured against
+   static Color ConvertColorExact(const Color& color, const BlindnessType& type);
+
+   static constexpr const double* SimulationMatrix(const BlindnessType& type)
+   {
+      switch (type)
+      {
+      case BlindnessType::PROTANOPIA: return PROTANOPIA_MATRIX;
+      case BlindnessType::DEUTERANOPIA: return DEUTERANOPIA_MATRIX;
+      case BlindnessType::TRITANOPIA: return TRITANOPIA_MATRIX;
+      case BlindnessType::DEUTERANOMALY: return DEUTERANOMALY_MATRIX;
+      case BlindnessType::PROTANOMALY: return PROTANOMALY_MATRIX;
+      case BlindnessType::TRITANOMALY: return TRITANOMALY_MATRIX;
+      default: return IDENTITY_MATRIX;
+      }
+   }
    static void StandardToLinear(const Color& standard, double* r, double* g, double* b);
    static void LinearToStandard(const double& r, const double& g, const double& b, Color* standard);
    static Color WavelengthToStandard(double wavelength);
@@ -126,6 +279,76 @@ struct Converter
                            double* convertedR, double* convertedG, double* convertedB);
 };
 
+template <BlindnessType T>
+Color Converter::Convert(const Color& color)
+{
+   if constexpr (T == BlindnessType::NORMAL)
+   {
+      return color;
+   }
+   else
+   {
+      constexpr const double* matrix = SimulationMatrix(T);
+      const SrgbTables& tables = SrgbTables::Get();
+      double r = tables.m_Decode[color.r];
+      double g = tables.m_Decode[color.g];
+      double b = tables.m_Decode[color.b];
+      return Color(tables.Encode(matrix[0]*r + matrix[1]*g + matrix[2]*b),
+                   tables.Encode(matrix[3]*r + matrix[4]*g + matrix[5]*b),
+                   tables.Encode(matrix[6]*r + matrix[7]*g + matrix[8]*b));
+   }
+}
+
+template <BlindnessType T>
+void Converter::ConvertColors(const Color* colors, size_t count, Color* converted)
+{
+   if constexpr (T == BlindnessType::NORMAL)
+   {
+      if (colors != converted) { std::copy(colors, colors + count, converted); }
+   }
+   else
+   {
+      constexpr const double* matrix = SimulationMatrix(T);
+      const double* decode = SrgbTables::Get().m_Decode;
+
+      // Work through structure-of-arrays chunks small enough to stay in L1
+      const size_t CHUNK_SIZE = 64;
+      alignas(32) double r[CHUNK_SIZE] = {}, g[CHUNK_SIZE] = {}, b[CHUNK_SIZE] = {};
+      unsigned char standardR[CHUNK_SIZE], standardG[CHUNK_SIZE], standardB[CHUNK_SIZE];
+
+      for (size_t begin = 0; begin < count; begin += CHUNK_SIZE)
+      {
+         size_t chunk = std::min(CHUNK_SIZE, count - begin);
+         for (size_t i = 0; i < chunk; i++)
+         {
+            const Color& color = colors[begin + i];
+            r[i] = decode[color.r];
+            g[i] = decode[color.g];
+            b[i] = decode[color.b];
+         }
+
+         // Constant coefficients and a fixed trip count, so this loop
+         // vectorizes. A short last chunk just multiplies stale values.
+         for (size_t i = 0; i < CHUNK_SIZE; i++)
+         {
+            double red = r[i], green = g[i], blue = b[i];
+            r[i] = matrix[0]*red + matrix[1]*green + matrix[2]*blue;
+            g[i] = matrix[3]*red + matrix[4]*green + matrix[5]*blue;
+            b[i] = matrix[6]*red + matrix[7]*green + matrix[8]*blue;
+         }
+
+         kernels::Encode(r, standardR, chunk);
+         kernels::Encode(g, standardG, chunk);
+         kernels::Encode(b, standardB, chunk);
+
+         for (size_t i = 0; i < chunk; i++)
+         {
+            converted[begin + i] = Color(standardR[i], standardG[i], standardB[i]);
+         }
+      }
+   }
+}
+
 class Palettes
 {
 public:
@@ -140,6 +363,10 @@ private:
    size_t AddPalette(const Palette& palette);
 
    void GenerateBlindnessPalettes(const size_t id);
+   // Scores every stored type of the palette from its NORMAL colors, each
+   // type converted afresh. A stored converted palette edited after
+   // GenerateBlindnessPalettes gets the score of the conversion, not of its
+   // own colors.
    void EvaluateColorPalettes(const size_t id);
 
    size_t GenerateAllBlack();
@@ -147,20 +374,223 @@ private:
    size_t GenerateVisibleSpectrum();
 };
 
+// How a multi-type GA folds each individual's per-type scores into one
+enum MultiTypeFitness : size_t
+{
+   WORST_CASE, WEIGHTED
+};
+
+// How PalettesGA combines two parents into a child
+enum CrossoverMethod : size_t
+{
+   // First parent's colors up to a random point, the second's after it
+   ONE_POINT,
+   // Second parent's colors between two random points
+   TWO_POINT,
+   // Each color from either parent at random
+   UNIFORM,
+   // Each channel at one random point between the parents' values
+   BLEND
+};
+
+// How PalettesGA mutates a child. Shifts saturate at 0 and 255.
+enum MutationMethod : size_t
+{
+   // Each color picked at the mutation rate, every channel shifted by up to 25
+   UNIFORM_SHIFT,
+   // Same, with a roughly normal shift of standard deviation 15
+   GAUSSIAN_SHIFT,
+   // Each channel picked and shifted on its own
+   CHANNEL_SHIFT
+};
+
+// How PalettesGA picks the parents of the next generation
+enum SelectionMethod : size_t
+{
+   // The fitter half of the population
+   TRUNCATION,
+   // Best of a few individuals drawn at random, once per parent
+   TOURNAMENT,
+   // Drawn with a weight that falls linearly with rank
+   RANK
+};
+
 class PalettesGA
 {
 public:
-   PalettesGA(const BlindnessType type, const size_t size);
+   // A run is fully determined by its seed, whatever the thread count
+   PalettesGA(const BlindnessType type, const size_t size, const DistanceMetric metric = DistanceMetric::RGB,
+              const uint64_t seed = 0);
+   // Evolves one palette for every type in types. Fitness is the lowest
+   // total across them, or the weighted mean with one weight per type.
+   PalettesGA(const std::vector<BlindnessType>& types, const size_t size,
+              const MultiTypeFitness fitness = MultiTypeFitness::WORST_CASE,
+              const std::vector<double>& weights = {}, const DistanceMetric metric = DistanceMetric::RGB,
+              const uint64_t seed = 0);
    void RunGA(const size_t numGenerations, const double mutationRate, const double crossoverRate);
+   // Convert and evaluate individuals on a pool of threadCount threads (0
+   // for one per core), chunkSize individuals per task. Until this is
+   // called the shared pool is used one individual at a time.
+   void SetParallelism(const size_t threadCount, const size_t chunkSize = 1);
+   // Truncation selection until this is called. tournamentSize only
+   // matters to TOURNAMENT.
+   void SetSelection(const SelectionMethod method, const size_t tournamentSize = 2);
+   // ONE_POINT until this is called
+   void SetCrossover(const CrossoverMethod method);
+   // UNIFORM_SHIFT until this is called
+   void SetMutation(const MutationMethod method);
 private:
-   std::vector<std::pair<Palette, Palette>> m_Palettes;
-   BlindnessType m_Type;
+   friend class PalettesIslands;
+   // Lets the tests and the benchmark run single steps
+   friend struct GAAccess;
+
+   struct Individual
+   {
+      Individual(const Palette& palette) : m_Palette(palette) {}
+      Palette m_Palette;
+      // Converted colors for every type in m_Types, one run after another
+      std::vector<Color> m_Converted;
+      // With the RGB metric, one incrementally evaluated palette per type
+      // holding that type's run of m_Converted, while m_ViewsValid is set
+      std::vector<Palette> m_Views;
+      bool m_ViewsValid = false;
+      double m_Fitness = 0;
+   };
+   // Current generation and the arena the next one is built in. They swap
+   // every generation, so after the first one nothing is allocated.
+   std::vector<Individual> m_Palettes;
+   std::vector<Individual> m_NextPalettes;
+   // Fitness and population index of every individual, reordered by
+   // selection in place of the population itself
+   struct Ranked
+   {
+      double m_Fitness;
+      size_t m_Index;
+      bool operator>(const Ranked& other) const
+      {
+         return m_Fitness > other.m_Fitness || (m_Fitness == other.m_Fitness && m_Index < other.m_Index);
+      }
+   };
+   std::vector<Ranked> m_Ranking;
+   // Population indices of the selected parents
+   std::vector<size_t> m_Parents;
+   SelectionMethod m_Selection;
+   size_t m_TournamentSize;
+   // Running sums of the RANK weights, best rank first
+   std::vector<double> m_RankWeights;
+   CrossoverMethod m_Crossover;
+   MutationMethod m_Mutation;
+   std::vector<BlindnessType> m_Types;
+   std::vector<Converter::ConvertColorsFunction> m_ConvertColors;
+   MultiTypeFitness m_Fitness;
+   std::vector<double> m_Weights;
+   DistanceMetric m_Metric;
    size_t m_PopulationSize;
+   std::unique_ptr<ThreadPool> m_OwnedPool;
+   ThreadPool* m_Pool;
+   size_t m_ChunkSize;
+   // Serial steps draw from m_Random. Work on individual i of a generation
+   // draws from its own stream, numbered by m_NextStream + i, so results do
+   // not depend on which thread runs it.
+   uint64_t m_Seed;
+   Random m_Random;
+   uint64_t m_NextStream;
+   // Whether every m_Fitness is up to date with its colors
+   bool m_Evaluated;
 private:
+   // One generation without output, returns the best fitness before it
+   double RunGeneration(const double mutationRate, const double crossoverRate);
+   // Draws the fittest individual without touching selection or m_Random,
+   // so a later RunGA continues as if nothing had been drawn
+   void DrawBest();
+   // Index of the highest fitness, the lowest index on ties
+   size_t Fittest() const;
+   // Copies of the emigrants.size() fittest individuals, best first
+   void Emigrate(std::vector<Individual>& emigrants);
+   // Immigrants replace the least fit individuals
+   void Immigrate(const std::vector<const Individual*>& immigrants);
+   void ConvertPalette(Individual& individual) const;
+   // Converts only the colors whose bit is set in dirty, one bit per color
+   void ConvertDirty(Individual& individual, const std::vector<uint64_t>& dirty) const;
+   void ConvertPopulation();
+   void BuildViews(Individual& individual) const;
+   // Scores a child from the parent it was copied from. An unchanged child
+   // takes the parent's fitness, one that differs in at most a quarter of
+   // its converted colors starts from the parent's views and reprices only
+   // those, any other is scored in full without views.
+   void EvaluateChild(Individual& child, const Individual& parent) const;
+   void EvaluateIndividual(Individual& individual) const;
    void EvaluatePopulation();
-   std::vector<Palette> SelectParents(double& averageDistance);
-   Palette Crossover(const Palette& parent1, const Palette& parent2);
-   void Mutate(Palette& palette, const double mutationRate);
+   // Runs function(individual, index) on every individual, chunks of them
+   // spread over m_Pool
+   template <typename Function> void ForEachIndividual(Function function);
+   void SelectParents(double& averageDistance);
+   void SelectTruncation();
+   void SelectTournament();
+   void SelectRank();
+   // False when the child has new colors rather than its parents', and so
+   // needs converting in full
+   bool Crossover(const Individual& parent1, const Individual& parent2, Individual& child, Random& random) const;
+   // Leaves the indices of the colors that actually changed in changed
+   void Mutate(Palette& palette, const double mutationRate, Random& random, std::vector<size_t>& changed) const;
+};
+
+// Where PalettesIslands sends each island's migrants
+enum MigrationTopology : size_t
+{
+   // To the next island, the last one sending to the first
+   RING,
+   // To every other island
+   ALL_TO_ALL
+};
+
+// Island model: independent PalettesGA populations evolving side by side,
+// one island per pool task, that swap their fittest individuals every few
+// generations. Like PalettesGA, a run is fully determined by its seed.
+class PalettesIslands
+{
+public:
+   PalettesIslands(const BlindnessType type, const size_t islands, const size_t size,
+                   const DistanceMetric metric = DistanceMetric::RGB, const uint64_t seed = 0);
+   PalettesIslands(const std::vector<BlindnessType>& types, const size_t islands, const size_t size,
+                   const MultiTypeFitness fitness = MultiTypeFitness::WORST_CASE,
+                   const std::vector<double>& weights = {}, const DistanceMetric metric = DistanceMetric::RGB,
+                   const uint64_t seed = 0);
+   void RunGA(const size_t numGenerations, const double mutationRate, const double crossoverRate);
+   // Every interval generations each island sends copies of its migrants
+   // fittest individuals along topology, migrants being capped at the island
+   // size. RING, 10 and 2 until this is called.
+   void SetMigration(const MigrationTopology topology, const size_t interval, const size_t migrants);
+   // Run the islands on a pool of threadCount threads (0 for one per core)
+   // rather than the shared one
+   void SetParallelism(const size_t threadCount);
+   // For per-island settings such as SetSelection
+   PalettesGA& GetIsland(size_t index) { return m_Islands[index]; }
+   size_t IslandCount() const { return m_Islands.size(); }
+private:
+   // Written only by its island and read by the ones it sends to. Slots
+   // alternate by epoch, so an island can fill one while its neighbors
+   // still read the last. Epochs run as separate ParallelFor calls, and
+   // that barrier orders every Send before the Receives that read it.
+   struct Mailbox
+   {
+      std::vector<PalettesGA::Individual> m_Migrants[2];
+   };
+   std::vector<PalettesGA> m_Islands;
+   std::vector<Mailbox> m_Mailboxes;
+   MigrationTopology m_Topology;
+   size_t m_Interval;
+   size_t m_Migrants;
+   std::unique_ptr<ThreadPool> m_OwnedPool;
+   ThreadPool* m_Pool;
+private:
+   friend struct GAAccess;
+
+   // Every island runs generations generations, taking in the migrants of
+   // the previous epoch first and sending its own at the end
+   void RunEpoch(size_t epoch, size_t generations, const double mutationRate, const double crossoverRate);
+   void Send(size_t island, size_t epoch);
+   void Receive(size_t island, size_t epoch);
 };
 
 };
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "Palette.h"
+
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace color
+{
+
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator
+{
+   using value_type = T;
+   template <typename U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+   AlignedAllocator() = default;
+   template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+   T* allocate(size_t count)
+   {
+      return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+   }
+   void deallocate(T* pointer, size_t)
+   {
+      ::operator delete(pointer, std::align_val_t(Alignment));
+   }
+
+   template <typename U> bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+   template <typename U> bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// Structure-of-arrays layout of a palette: one 64-byte aligned array per
+// channel, holding 0-255 values as T (uint8_t, int32_t, float, ...). Arrays
+// are zero padded to a whole cache line so kernels can run full-width
+// vectors to the end. Iterating yields Colors, so code written against
+// Palette::m_Colors can walk it the same way.
+template <typename T>
+class PaletteChannels
+{
+public:
+   static const size_t LANES = 64 / sizeof(T) > 0 ? 64 / sizeof(T) : 1;
+
+   class ConstIterator
+   {
+   public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = Color;
+      using difference_type = std::ptrdiff_t;
+      using pointer = void;
+      using reference = Color;
+
+      ConstIterator(const PaletteChannels* channels, size_t index) : m_Channels(channels), m_Index(index) {}
+      Color operator*() const { return (*m_Channels)[m_Index]; }
+      ConstIterator& operator++() { m_Index++; return *this; }
+      ConstIterator operator++(int) { ConstIterator previous = *this; m_Index++; return previous; }
+      bool operator==(const ConstIterator& other) const { return m_Index == other.m_Index; }
+      bool operator!=(const ConstIterator& other) const { return m_Index != other.m_Index; }
+   private:
+      const PaletteChannels* m_Channels;
+      size_t m_Index;
+   };
+
+   PaletteChannels() : m_Size(0) {}
+   explicit PaletteChannels(const Palette& palette) : m_Size(0) { Assign(palette); }
+
+   void Assign(const Palette& palette) { Assign(palette.m_Colors.data(), palette.m_Colors.size()); }
+   void Assign(const Color* colors, size_t count)
+   {
+      Resize(count);
+      for (size_t i = 0; i < count; i++)
+      {
+         m_R[i] = T(colors[i].r);
+         m_G[i] = T(colors[i].g);
+         m_B[i] = T(colors[i].b);
+      }
+   }
+   // Write the channels back as colors into an existing palette
+   void Store(Palette& palette) const
+   {
+      palette.m_Colors.resize(m_Size);
+      for (size_t i = 0; i < m_Size; i++)
+      {
+         palette.m_Colors[i] = (*this)[i];
+      }
+   }
+
+   // Keeps existing values, new and padding entries are zero
+   void Resize(size_t size)
+   {
+      size_t padded = (size + LANES - 1) / LANES * LANES;
+      m_R.resize(padded);
+      m_G.resize(padded);
+      m_B.resize(padded);
+      for (size_t i = size; i < padded; i++)
+      {
+         m_R[i] = m_G[i] = m_B[i] = T(0);
+      }
+      m_Size = size;
+   }
+
+   Color operator[](size_t index) const
+   {
+      return Color(ToChannel(m_R[index]), ToChannel(m_G[index]), ToChannel(m_B[index]));
+   }
+   void Set(size_t index, const Color& color)
+   {
+      m_R[index] = T(color.r);
+      m_G[index] = T(color.g);
+      m_B[index] = T(color.b);
+   }
+
+   ConstIterator begin() const { return ConstIterator(this, 0); }
+   ConstIterator end() const { return ConstIterator(this, m_Size); }
+
+   size_t Size() const { return m_Size; }
+   // Size rounded up to whole vectors, every array is readable that far
+   size_t PaddedSize() const { return m_R.size(); }
+
+   T* R() { return m_R.data(); }
+   T* G() { return m_G.data(); }
+   T* B() { return m_B.data(); }
+   const T* R() const { return m_R.data(); }
+   const T* G() const { return m_G.data(); }
+   const T* B() const { return m_B.data(); }
+private:
+   static uint8_t ToChannel(T value)
+   {
+      // Floating point channels round to nearest, everything clamps to 0-255
+      if constexpr (std::is_floating_point<T>::value) { value = std::floor(value + T(0.5)); }
+      if (value <= T(0)) { return 0; }
+      if (value >= T(255)) { return 255; }
+      return uint8_t(value);
+   }
+private:
+   AlignedVector<T> m_R, m_G, m_B;
+   size_t m_Size;
+};
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Palette.h"
+#include "Kernels.h"
+
+#include <cstddef>
+
+namespace color
+{
+
+// Each 8-bit channel's share of CIE XYZ (relative to the D65 white) and of
+// Oklab's LMS cone response, precomputed through the standard sRGB decode.
+// A color's XYZ or LMS is then three table rows added up, no pow needed.
+struct PerceptualTables
+{
+   static const PerceptualTables& Get();
+
+   void Lab(const Color& color, float* L, float* a, float* b) const;
+   void Oklab(const Color& color, float* L, float* a, float* b) const;
+
+   // Largest distance between two corners of the RGB cube under a metric,
+   // what Palette::Evaluate normalizes by. For RGB that is 255 * sqrt(3).
+   double MaxDistance(DistanceMetric metric) const { return m_MaxDistance[std::min(metric, DistanceMetric::LAST_METRIC)]; }
+
+   double m_Xyz[3][256][3];
+   double m_Lms[3][256][3];
+   double m_MaxDistance[DistanceMetric::LAST_METRIC + 1];
+private:
+   PerceptualTables();
+};
+
+namespace perceptual
+{
+
+// Every color converted once into the metric's space as float channels:
+// 0-255 RGB, CIELAB for CIE76 and CIE2000, Oklab for OKLAB
+void Assign(const Color* colors, size_t count, DistanceMetric metric, float* x, float* y, float* z);
+
+// CIEDE2000 from one Lab color to count others in structure-of-arrays form.
+// Branch-free over the batch, so compilers with vector math libraries can
+// vectorize the whole loop.
+void DeltaE2000(float L, float a, float b, const float* otherL, const float* otherA, const float* otherB,
+                size_t count, double* distances);
+double DeltaE2000(float L1, float a1, float b1, float L2, float a2, float b2);
+
+// Same contract as kernels::PairDistances over Lab channels, with the
+// squared extremes holding squared CIEDE2000 values
+void DeltaE2000Pairs(const float* L, const float* a, const float* b,
+                     size_t rowBegin, size_t rowEnd, size_t columnBegin, size_t columnEnd, kernels::PairStats& stats);
+
+}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace color
+{
+
+// xoshiro256** (Blackman and Vigna). Fast, 256 bits of state and good
+// enough statistically for the GA. Each instance is one stream, meant to be
+// owned by a single thread; streams built from the same seed with different
+// stream numbers do not overlap in practice.
+class Random
+{
+public:
+   explicit Random(uint64_t seed = 0, uint64_t stream = 0) { Seed(seed, stream); }
+
+   // The state comes from SplitMix64 over the seed and stream number, so
+   // nearby seeds still give unrelated streams
+   void Seed(uint64_t seed, uint64_t stream = 0);
+
+   uint64_t Next()
+   {
+      uint64_t result = Rotate(m_State[1] * 5, 7) * 9;
+      uint64_t shifted = m_State[1] << 17;
+      m_State[2] ^= m_State[0];
+      m_State[3] ^= m_State[1];
+      m_State[1] ^= m_State[2];
+      m_State[0] ^= m_State[3];
+      m_State[2] ^= shifted;
+      m_State[3] = Rotate(m_State[3], 45);
+      return result;
+   }
+   // Unbiased integer in [0, bound), Lemire's multiply and reject
+   uint32_t Uniform(uint32_t bound)
+   {
+      uint64_t product = (Next() >> 32) * bound;
+      if (uint32_t(product) < bound)
+      {
+         uint32_t threshold = uint32_t(-bound) % bound;
+         while (uint32_t(product) < threshold)
+         {
+            product = (Next() >> 32) * bound;
+         }
+      }
+      return uint32_t(product >> 32);
+   }
+   // Double in [0, 1) from the top 53 bits
+   double Real() { return double(Next() >> 11) * (1.0 / 9007199254740992.0); }
+   bool Chance(double probability) { return Real() < probability; }
+
+   // Raw words for bulk draws, such as the mutation pass slicing its rolls
+   // and shifts out of one or two words per color
+   void Fill(uint64_t* values, size_t count);
+private:
+   static uint64_t Rotate(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+   uint64_t m_State[4];
+};
+
+}
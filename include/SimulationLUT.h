@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Palette.h"
+
+#include <string>
+#include <vector>
+
+namespace color
+{
+
+// Precomputed sRGB -> simulated sRGB tables, one per BlindnessType. A lookup is
+// a tetrahedral interpolation between grid points instead of the full
+// linearize/matrix/encode chain. Tables can be saved and memory-mapped back
+// so they only have to be computed once per machine.
+class SimulationLUT
+{
+public:
+   // Build tables with gridSize points per axis (33 and 65 are typical). With a
+   // cache path, map the tables from it if it matches, else build and save them.
+   // The grid size goes into the cache file name, see CacheFileName.
+   explicit SimulationLUT(size_t gridSize = 33, const std::string& cachePath = "");
+   ~SimulationLUT();
+   SimulationLUT(const SimulationLUT&) = delete;
+   SimulationLUT& operator=(const SimulationLUT&) = delete;
+
+   // Types past the last one convert as NORMAL, like Converter
+   Color Convert(const Color& color, const BlindnessType& type) const;
+   void ConvertColors(const Color* colors, size_t count, const BlindnessType& type, Color* converted) const;
+   void ConvertPalette(const Palette& palette, const BlindnessType& type, Palette& converted) const;
+
+   bool Save(const std::string& path) const;
+   bool Load(const std::string& path);
+
+   // "lut.bin" with a grid size of 33 becomes "lut.33.bin"
+   static std::string CacheFileName(const std::string& path, size_t gridSize);
+
+   // Largest per-channel difference from Converter::ConvertColorExact, sampling
+   // every step-th value (plus 255) along each axis
+   size_t MaxError(const BlindnessType& type, size_t step = 1) const;
+   void PrintAccuracy(size_t step = 1) const;
+
+   size_t GridSize() const { return m_GridSize; }
+   bool IsMapped() const { return m_Mapping != nullptr; }
+private:
+   void Build();
+   void BuildAxis();
+   void Unmap();
+   const float* Table(const BlindnessType& type) const;
+   Color Interpolate(const float* table, const Color& color) const;
+private:
+   struct Tetrahedron
+   {
+      size_t m_First;
+      size_t m_Second;
+      unsigned char m_Order[3];
+   };
+
+   // r, g, b and one pad float, so a node is a single 16-byte load
+   static const size_t NODE_SIZE = 4;
+
+   size_t m_GridSize;
+   // Grid cell and position inside it for each 8-bit input channel
+   size_t m_AxisIndex[256];
+   float m_AxisFraction[256];
+   // Corner offsets and weight order for each tetrahedron of a cell
+   Tetrahedron m_Tetrahedra[8];
+
+   // Interleaved r, g, b outputs on the 0-255 scale, all types back to back.
+   // Points at m_Tables or into the mapped file.
+   const float* m_Data;
+   std::vector<float> m_Tables;
+
+   void* m_Mapping;
+   void* m_MappingHandle;
+   size_t m_MappingSize;
+};
+
+}
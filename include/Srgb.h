@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+
+namespace color
+{
+
+// Transfer curves precomputed for every 8-bit channel value. Channels are
+// always 0-255, so the gamma math only ever needs to run 256 times.
+struct SrgbTables
+{
+   static const SrgbTables& Get();
+
+   // Encode a linear value to its 8-bit sRGB channel, clamping out-of-range
+   // (and NaN) input to 0-255. Same result as the pow() curve for 0-1 input.
+   size_t Encode(double linear) const
+   {
+      if (!(linear > 0.0)) { return 0; }
+      if (linear >= 1.0) { return 255; }
+      size_t channel = m_EncodeBuckets[static_cast<size_t>(linear * ENCODE_BUCKETS)];
+      while (linear >= m_EncodeThresholds[channel + 1]) { channel++; }
+      return channel;
+   }
+
+   // The unquantized curves the tables are built from, on the 0-255 scale
+   static double DecodeCurve(double standard);
+   static double EncodeCurve(double linear);
+
+   static const size_t ENCODE_BUCKETS = 4096;
+
+   // Linear value of each 8-bit channel (same curve as Converter::StandardToLinear)
+   double m_Decode[256];
+   // Smallest linear value that encodes to each channel, +inf past the end
+   double m_EncodeThresholds[257];
+   // Channel at the start of each uniform bucket of the 0-1 linear range.
+   // A bucket never spans more than one channel step. Entry ENCODE_BUCKETS
+   // holds 255 for an input of exactly 1, and the tail pads 32-bit gathers.
+   unsigned char m_EncodeBuckets[ENCODE_BUCKETS + 4];
+
+private:
+   SrgbTables();
+};
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace color
+{
+
+// Fixed set of worker threads that split a run of indexed tasks with the
+// calling thread. Tasks are claimed one at a time from a shared counter, so
+// uneven tasks still balance. A Run issued while another is in flight,
+// including one from inside a task, executes inline on its caller.
+class ThreadPool
+{
+public:
+   using TaskFunction = void (*)(void* context, size_t index);
+
+   // 0 threads sizes the pool to the machine
+   explicit ThreadPool(size_t threadCount = 0);
+   ~ThreadPool();
+   ThreadPool(const ThreadPool&) = delete;
+   ThreadPool& operator=(const ThreadPool&) = delete;
+
+   static ThreadPool& Shared();
+
+   // Threads taking part in a Run, the caller included
+   size_t ThreadCount() const { return m_Workers.size() + 1; }
+   // Calls task(context, i) for every i in [0, taskCount) and returns when
+   // all of them are done
+   void Run(size_t taskCount, TaskFunction task, void* context);
+   template <typename Function> void ParallelFor(size_t taskCount, Function& function);
+private:
+   std::vector<std::thread> m_Workers;
+   std::mutex m_RunMutex;
+   std::mutex m_Mutex;
+   std::condition_variable m_WakeCondition;
+   std::condition_variable m_DoneCondition;
+   TaskFunction m_Task = nullptr;
+   void* m_Context = nullptr;
+   size_t m_TaskCount = 0;
+   std::atomic<size_t> m_NextTask{0};
+   size_t m_Generation = 0;
+   size_t m_ActiveWorkers = 0;
+   bool m_Stop = false;
+private:
+   void WorkerLoop();
+   void Work();
+};
+
+template <typename Function>
+void ThreadPool::ParallelFor(size_t taskCount, Function& function)
+{
+   Run(taskCount, [](void* context, size_t index) { (*static_cast<Function*>(context))(index); }, &function);
+}
+
+}
@@ -0,0 +1,87 @@
+#include "ColorCoverage.h"
+
+#include <bitset>
+#include <cstring>
+
+namespace color {
+
+static const size_t SHIFT = 8 - ColorCoverage::AXIS_BITS;
+// Lowest and highest b bin of every 16-bit row in a word
+static const uint64_t FIRST_B = 0x0001000100010001ull;
+static const uint64_t LAST_B = 0x8000800080008000ull;
+
+void ColorCoverage::Clear()
+{
+   std::memset(m_Words, 0, sizeof(m_Words));
+}
+void ColorCoverage::Assign(const Color* colors, size_t count)
+{
+   Clear();
+   for (size_t i = 0; i < count; i++)
+   {
+      Add(colors[i]);
+   }
+}
+void ColorCoverage::Add(const Color& color)
+{
+   size_t bin = (size_t(color.r >> SHIFT) << (2 * AXIS_BITS)) | (size_t(color.g >> SHIFT) << AXIS_BITS) | (color.b >> SHIFT);
+   m_Words[bin / 64] |= uint64_t(1) << (bin % 64);
+}
+void ColorCoverage::Dilate()
+{
+   // A box dilation is separable, grow along b, then g, then r
+   for (uint64_t& word : m_Words)
+   {
+      word |= ((word << 1) & ~FIRST_B) | ((word >> 1) & ~LAST_B);
+   }
+
+   const size_t WORDS_PER_SLICE = WORDS / AXIS;
+   uint64_t grown[WORDS];
+   for (size_t i = 0; i < WORDS; i++)
+   {
+      // g rows shift by 16 bits inside a word and carry over into the
+      // neighboring words of the same r slice
+      uint64_t word = m_Words[i];
+      word |= (m_Words[i] << 16) | (m_Words[i] >> 16);
+      if (i % WORDS_PER_SLICE != 0)
+      {
+         word |= m_Words[i - 1] >> 48;
+      }
+      if (i % WORDS_PER_SLICE != WORDS_PER_SLICE - 1)
+      {
+         word |= m_Words[i + 1] << 48;
+      }
+      grown[i] = word;
+   }
+
+   for (size_t i = 0; i < WORDS; i++)
+   {
+      uint64_t word = grown[i];
+      if (i >= WORDS_PER_SLICE)
+      {
+         word |= grown[i - WORDS_PER_SLICE];
+      }
+      if (i + WORDS_PER_SLICE < WORDS)
+      {
+         word |= grown[i + WORDS_PER_SLICE];
+      }
+      m_Words[i] = word;
+   }
+}
+size_t ColorCoverage::Count() const
+{
+   size_t count = 0;
+   for (uint64_t word : m_Words)
+   {
+      count += std::bitset<64>(word).count();
+   }
+   return count;
+}
+double ColorCoverage::Representation(const Color* colors, size_t count)
+{
+   ColorCoverage coverage(colors, count);
+   coverage.Dilate();
+   return coverage.Fraction();
+}
+
+}
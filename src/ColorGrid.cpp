@@ -0,0 +1,160 @@
+#include "ColorGrid.h"
+
+#include <algorithm>
+
+namespace color {
+
+static uint32_t SquaredDistance(const Color& a, const Color& b)
+{
+   int dr = int(a.r) - int(b.r);
+   int dg = int(a.g) - int(b.g);
+   int db = int(a.b) - int(b.b);
+   return uint32_t(dr * dr + dg * dg + db * db);
+}
+
+ColorGrid::ColorGrid(const Palette& palette)
+{
+   Build(palette.m_Colors.data(), palette.m_Colors.size());
+}
+void ColorGrid::Build(const Color* colors, size_t count)
+{
+   // 2^(3 * bits) cells for about one color each, capped at 64 per axis
+   int bits = 0;
+   while (bits < 6 && (size_t(1) << (3 * bits)) < count)
+   {
+      bits++;
+   }
+   m_Cells = 1 << bits;
+   m_Shift = 8 - bits;
+
+   // Counting sort by cell
+   size_t cellCount = size_t(m_Cells) * m_Cells * m_Cells;
+   m_CellStart.assign(cellCount + 1, 0);
+   for (size_t i = 0; i < count; i++)
+   {
+      m_CellStart[Cell(colors[i].r >> m_Shift, colors[i].g >> m_Shift, colors[i].b >> m_Shift) + 1]++;
+   }
+   for (size_t cell = 0; cell < cellCount; cell++)
+   {
+      m_CellStart[cell + 1] += m_CellStart[cell];
+   }
+
+   m_Colors.resize(count);
+   m_Indices.resize(count);
+   std::vector<uint32_t> next(m_CellStart.begin(), m_CellStart.end() - 1);
+   for (size_t i = 0; i < count; i++)
+   {
+      uint32_t slot = next[Cell(colors[i].r >> m_Shift, colors[i].g >> m_Shift, colors[i].b >> m_Shift)]++;
+      m_Colors[slot] = colors[i];
+      m_Indices[slot] = uint32_t(i);
+   }
+}
+size_t ColorGrid::Nearest(const Color& query, uint32_t* squared, size_t exclude) const
+{
+   uint32_t bestSquared = UINT32_MAX;
+   size_t bestIndex = NONE;
+   Search(query, exclude, bestSquared, bestIndex);
+   if (squared)
+   {
+      *squared = bestSquared;
+   }
+   return bestIndex;
+}
+void ColorGrid::NearestSquared(std::vector<uint32_t>& squared) const
+{
+   squared.assign(m_Colors.size(), UINT32_MAX);
+   for (size_t slot = 0; slot < m_Colors.size(); slot++)
+   {
+      size_t bestIndex = NONE;
+      Search(m_Colors[slot], m_Indices[slot], squared[m_Indices[slot]], bestIndex);
+   }
+}
+uint32_t ColorGrid::ClosestPair(size_t* first, size_t* second) const
+{
+   // Every search starts from the best pair so far, later ones prune early
+   uint32_t bestSquared = UINT32_MAX;
+   size_t bestFirst = NONE, bestSecond = NONE;
+   for (size_t slot = 0; slot < m_Colors.size() && bestSquared > 0; slot++)
+   {
+      size_t bestIndex = NONE;
+      Search(m_Colors[slot], m_Indices[slot], bestSquared, bestIndex);
+      if (bestIndex != NONE)
+      {
+         bestFirst = m_Indices[slot];
+         bestSecond = bestIndex;
+      }
+   }
+   if (first)
+   {
+      *first = bestFirst;
+   }
+   if (second)
+   {
+      *second = bestSecond;
+   }
+   return bestSquared;
+}
+void ColorGrid::Search(const Color& query, size_t exclude, uint32_t& bestSquared, size_t& bestIndex) const
+{
+   const int cellSize = 1 << m_Shift;
+   const int qx = query.r >> m_Shift, qy = query.g >> m_Shift, qz = query.b >> m_Shift;
+
+   auto visit = [&](int x, int y, int z)
+   {
+      size_t cell = Cell(x, y, z);
+      for (uint32_t slot = m_CellStart[cell]; slot < m_CellStart[cell + 1]; slot++)
+      {
+         uint32_t squared = SquaredDistance(query, m_Colors[slot]);
+         if (squared < bestSquared && m_Indices[slot] != exclude)
+         {
+            bestSquared = squared;
+            bestIndex = m_Indices[slot];
+         }
+      }
+   };
+
+   for (int radius = 0; radius < m_Cells; radius++)
+   {
+      // A cell radius steps away is at least (radius - 1) whole cells plus
+      // one channel step from the query along some axis
+      if (radius > 0)
+      {
+         uint32_t reach = uint32_t((radius - 1) * cellSize + 1);
+         if (bestSquared <= reach * reach)
+         {
+            return;
+         }
+      }
+
+      int x0 = std::max(qx - radius, 0), x1 = std::min(qx + radius, m_Cells - 1);
+      int y0 = std::max(qy - radius, 0), y1 = std::min(qy + radius, m_Cells - 1);
+      int z0 = std::max(qz - radius, 0), z1 = std::min(qz + radius, m_Cells - 1);
+      for (int x = x0; x <= x1; x++)
+      {
+         for (int y = y0; y <= y1; y++)
+         {
+            if (x == qx - radius || x == qx + radius || y == qy - radius || y == qy + radius)
+            {
+               for (int z = z0; z <= z1; z++)
+               {
+                  visit(x, y, z);
+               }
+            }
+            else
+            {
+               // Inside the shell's x/y extent only its two z faces are new
+               if (qz - radius >= 0)
+               {
+                  visit(x, y, qz - radius);
+               }
+               if (radius > 0 && qz + radius < m_Cells)
+               {
+                  visit(x, y, qz + radius);
+               }
+            }
+         }
+      }
+   }
+}
+
+}
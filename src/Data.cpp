@@ -1,6 +1,6 @@
 #include "Data.h"
 
-static const size_t Default[256 * 3] =
+static const uint8_t Default[256 * 3] =
 {
    /*   0 */   0,   0, 255,
    /*   1 */   0, 255, 255,
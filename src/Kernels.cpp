@@ -0,0 +1,389 @@
+#include "Kernels.h"
+#include "Srgb.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef COLOR_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace color {
+namespace kernels {
+
+// CPU detection
+bool HasAvx2()
+{
+#if defined(COLOR_SIMD_X86) && defined(_MSC_VER)
+   static const bool avx2 = []() {
+      int info[4];
+      __cpuid(info, 0);
+      if (info[0] < 7) { return false; }
+
+      // AVX needs OSXSAVE and the OS saving the YMM state
+      __cpuid(info, 1);
+      if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) { return false; }
+      if ((_xgetbv(0) & 0x6) != 0x6) { return false; }
+
+      __cpuidex(info, 7, 0);
+      return (info[1] & (1 << 5)) != 0;
+   }();
+   return avx2;
+#elif defined(COLOR_SIMD_X86)
+   static const bool avx2 = __builtin_cpu_supports("avx2");
+   return avx2;
+#else
+   return false;
+#endif
+}
+
+// Scalar
+static void EncodeScalar(const double* linear, unsigned char* channels, size_t begin, size_t count)
+{
+   const SrgbTables& tables = SrgbTables::Get();
+   for (size_t i = begin; i < count; i++)
+   {
+      channels[i] = static_cast<unsigned char>(tables.Encode(linear[i]));
+   }
+}
+
+static void SelectColorsScalar(const unsigned char* first, const unsigned char* second, const uint64_t* bits,
+                               unsigned char* out, size_t begin, size_t colors)
+{
+   for (size_t i = begin; i < colors; i++)
+   {
+      const unsigned char* source = (bits[i / 64] >> (i % 64)) & 1 ? first : second;
+      std::memcpy(out + 4 * i, source + 4 * i, 4);
+   }
+}
+
+static void BlendBytesScalar(const unsigned char* first, const unsigned char* second, unsigned weight,
+                             unsigned char* out, size_t begin, size_t count)
+{
+   for (size_t i = begin; i < count; i++)
+   {
+      out[i] = static_cast<unsigned char>((first[i] * (256 - weight) + second[i] * weight + 128) >> 8);
+   }
+}
+
+static void AddSaturatedScalar(unsigned char* bytes, const signed char* deltas, size_t begin, size_t count)
+{
+   for (size_t i = begin; i < count; i++)
+   {
+      bytes[i] = static_cast<unsigned char>(std::clamp(bytes[i] + deltas[i], 0, 255));
+   }
+}
+
+// Distances are buffered per block of columns, then summed in order
+static const size_t DISTANCE_BLOCK = 256;
+
+static float SquaredDistance(const float* r, const float* g, const float* b, size_t i, size_t j)
+{
+   float dr = r[j] - r[i], dg = g[j] - g[i], db = b[j] - b[i];
+   return dr * dr + dg * dg + db * db;
+}
+#ifndef COLOR_SIMD_X86
+static void PairDistancesScalar(const float* r, const float* g, const float* b,
+                                size_t rowBegin, size_t rowEnd, size_t columnBegin, size_t columnEnd, PairStats& stats)
+{
+   for (size_t i = rowBegin; i < rowEnd; i++)
+   {
+      for (size_t j = std::max(columnBegin, i + 1); j < columnEnd; j++)
+      {
+         float squared = SquaredDistance(r, g, b, i, j);
+         stats.m_MinSquared = std::min(stats.m_MinSquared, double(squared));
+         stats.m_MaxSquared = std::max(stats.m_MaxSquared, double(squared));
+         stats.m_Sum += sqrt(double(squared));
+         stats.m_Pairs++;
+      }
+   }
+}
+#endif
+
+#ifdef COLOR_SIMD_X86
+// SSE2
+static void EncodeSse2(const double* linear, unsigned char* channels, size_t count)
+{
+   const SrgbTables& tables = SrgbTables::Get();
+   const __m128d zero = _mm_setzero_pd();
+   const __m128d one = _mm_set1_pd(1.0);
+   const __m128d scale = _mm_set1_pd(double(SrgbTables::ENCODE_BUCKETS));
+
+   alignas(16) double clamped[2];
+   alignas(16) int buckets[4];
+   size_t i = 0;
+   for (; i + 2 <= count; i += 2)
+   {
+      // max() returns its second operand for NaN, so NaN clamps to 0
+      __m128d value = _mm_min_pd(_mm_max_pd(_mm_loadu_pd(linear + i), zero), one);
+      _mm_store_pd(clamped, value);
+      _mm_store_si128(reinterpret_cast<__m128i*>(buckets), _mm_cvttpd_epi32(_mm_mul_pd(value, scale)));
+
+      for (size_t lane = 0; lane < 2; lane++)
+      {
+         size_t channel = tables.m_EncodeBuckets[buckets[lane]];
+         if (clamped[lane] >= tables.m_EncodeThresholds[channel + 1]) { channel++; }
+         channels[i + lane] = static_cast<unsigned char>(channel);
+      }
+   }
+   EncodeScalar(linear, channels, i, count);
+}
+
+static void SelectColorsSse2(const unsigned char* first, const unsigned char* second, const uint64_t* bits,
+                             unsigned char* out, size_t colors)
+{
+   // Four colors per register, each lane masked by its own bit
+   const __m128i lanes = _mm_setr_epi32(1, 2, 4, 8);
+   size_t i = 0;
+   for (; i + 4 <= colors; i += 4)
+   {
+      int nibble = int((bits[i / 64] >> (i % 64)) & 0xF);
+      __m128i mask = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(nibble), lanes), lanes);
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 4 * i));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second + 4 * i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * i),
+                       _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)));
+   }
+   SelectColorsScalar(first, second, bits, out, i, colors);
+}
+
+static void BlendBytesSse2(const unsigned char* first, const unsigned char* second, unsigned weight,
+                           unsigned char* out, size_t count)
+{
+   // 16-bit lanes hold up to 255 * 256 + 128 without overflow
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i firstWeight = _mm_set1_epi16(short(256 - weight));
+   const __m128i secondWeight = _mm_set1_epi16(short(weight));
+   const __m128i round = _mm_set1_epi16(128);
+   size_t i = 0;
+   for (; i + 16 <= count; i += 16)
+   {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + i));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second + i));
+      __m128i low = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), firstWeight),
+                                                _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), secondWeight)), round);
+      __m128i high = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), firstWeight),
+                                                 _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), secondWeight)), round);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                       _mm_packus_epi16(_mm_srli_epi16(low, 8), _mm_srli_epi16(high, 8)));
+   }
+   BlendBytesScalar(first, second, weight, out, i, count);
+}
+
+static void AddSaturatedSse2(unsigned char* bytes, const signed char* deltas, size_t count)
+{
+   // SSE2 only saturates unsigned + unsigned, so add the positive part of
+   // each delta and subtract the negative part
+   const __m128i zero = _mm_setzero_si128();
+   size_t i = 0;
+   for (; i + 16 <= count; i += 16)
+   {
+      __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+      __m128i delta = _mm_loadu_si128(reinterpret_cast<const __m128i*>(deltas + i));
+      __m128i up = _mm_and_si128(delta, _mm_cmpgt_epi8(delta, zero));
+      __m128i down = _mm_and_si128(_mm_sub_epi8(zero, delta), _mm_cmplt_epi8(delta, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes + i), _mm_subs_epu8(_mm_adds_epu8(value, up), down));
+   }
+   AddSaturatedScalar(bytes, deltas, i, count);
+}
+
+static void PairDistancesSse2(const float* r, const float* g, const float* b,
+                              size_t rowBegin, size_t rowEnd, size_t columnBegin, size_t columnEnd, PairStats& stats)
+{
+   alignas(16) double distances[DISTANCE_BLOCK];
+   // Lanes start empty and merge into the double stats at the end
+   __m128 minSquared = _mm_set1_ps(FLT_MAX);
+   __m128 maxSquared = _mm_setzero_ps();
+   double sum = stats.m_Sum;
+
+   for (size_t i = rowBegin; i < rowEnd; i++)
+   {
+      __m128 red = _mm_set1_ps(r[i]), green = _mm_set1_ps(g[i]), blue = _mm_set1_ps(b[i]);
+      size_t j = std::max(columnBegin, i + 1);
+      while (j < columnEnd)
+      {
+         size_t blockEnd = std::min(j + DISTANCE_BLOCK, columnEnd);
+         size_t count = 0;
+         for (; j + 4 <= blockEnd; j += 4, count += 4)
+         {
+            __m128 dr = _mm_sub_ps(_mm_loadu_ps(r + j), red);
+            __m128 dg = _mm_sub_ps(_mm_loadu_ps(g + j), green);
+            __m128 db = _mm_sub_ps(_mm_loadu_ps(b + j), blue);
+            __m128 squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+            minSquared = _mm_min_ps(minSquared, squared);
+            maxSquared = _mm_max_ps(maxSquared, squared);
+            _mm_store_pd(distances + count, _mm_sqrt_pd(_mm_cvtps_pd(squared)));
+            _mm_store_pd(distances + count + 2, _mm_sqrt_pd(_mm_cvtps_pd(_mm_movehl_ps(squared, squared))));
+         }
+         for (; j < blockEnd; j++, count++)
+         {
+            __m128 squared = _mm_set1_ps(SquaredDistance(r, g, b, i, j));
+            minSquared = _mm_min_ps(minSquared, squared);
+            maxSquared = _mm_max_ps(maxSquared, squared);
+            distances[count] = sqrt(double(_mm_cvtss_f32(squared)));
+         }
+
+         for (size_t k = 0; k < count; k++) { sum += distances[k]; }
+         stats.m_Pairs += count;
+      }
+   }
+
+   alignas(16) float lanes[4];
+   _mm_store_ps(lanes, minSquared);
+   stats.m_MinSquared = std::min(stats.m_MinSquared, double(std::min({ lanes[0], lanes[1], lanes[2], lanes[3] })));
+   _mm_store_ps(lanes, maxSquared);
+   stats.m_MaxSquared = std::max(stats.m_MaxSquared, double(std::max({ lanes[0], lanes[1], lanes[2], lanes[3] })));
+   stats.m_Sum = sum;
+}
+
+// AVX2
+COLOR_TARGET_AVX2
+static void EncodeAvx2(const double* linear, unsigned char* channels, size_t count)
+{
+   const SrgbTables& tables = SrgbTables::Get();
+   const __m256d zero = _mm256_setzero_pd();
+   const __m256d one = _mm256_set1_pd(1.0);
+   const __m256d scale = _mm256_set1_pd(double(SrgbTables::ENCODE_BUCKETS));
+   const __m128i lowByte = _mm_set1_epi32(0xFF);
+   const __m256d allLanes = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+   const int* buckets = reinterpret_cast<const int*>(tables.m_EncodeBuckets);
+
+   size_t i = 0;
+   for (; i + 4 <= count; i += 4)
+   {
+      __m256d value = _mm256_min_pd(_mm256_max_pd(_mm256_loadu_pd(linear + i), zero), one);
+      __m128i bucket = _mm256_cvttpd_epi32(_mm256_mul_pd(value, scale));
+
+      // Gather 32 bits at each byte offset and keep the low byte
+      __m128i channel = _mm_and_si128(_mm_i32gather_epi32(buckets, bucket, 1), lowByte);
+
+      // A bucket spans at most one step, so one threshold compare finishes it.
+      // The masked gather takes a defined source, the plain one leaves it
+      // undefined and trips -Wmaybe-uninitialized.
+      __m256d threshold = _mm256_mask_i32gather_pd(zero, tables.m_EncodeThresholds + 1, channel, allLanes, 8);
+      __m256d step = _mm256_and_pd(_mm256_cmp_pd(value, threshold, _CMP_GE_OQ), one);
+      channel = _mm_add_epi32(channel, _mm256_cvttpd_epi32(step));
+
+      __m128i packed = _mm_packus_epi16(_mm_packs_epi32(channel, channel), channel);
+      int bytes = _mm_cvtsi128_si32(packed);
+      memcpy(channels + i, &bytes, 4);
+   }
+   EncodeScalar(linear, channels, i, count);
+}
+COLOR_TARGET_AVX2
+static void PairDistancesAvx2(const float* r, const float* g, const float* b,
+                              size_t rowBegin, size_t rowEnd, size_t columnBegin, size_t columnEnd, PairStats& stats)
+{
+   // Room for a full vector past the block, written by the masked tail
+   alignas(32) double distances[DISTANCE_BLOCK + 8];
+   const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+   const __m256 noMinimum = _mm256_set1_ps(FLT_MAX);
+   __m256 minSquared = noMinimum;
+   __m256 maxSquared = _mm256_setzero_ps();
+   double sum = stats.m_Sum;
+
+   for (size_t i = rowBegin; i < rowEnd; i++)
+   {
+      __m256 red = _mm256_set1_ps(r[i]), green = _mm256_set1_ps(g[i]), blue = _mm256_set1_ps(b[i]);
+      size_t j = std::max(columnBegin, i + 1);
+      while (j < columnEnd)
+      {
+         size_t blockEnd = std::min(j + DISTANCE_BLOCK, columnEnd);
+         size_t count = 0;
+         for (; j + 8 <= blockEnd; j += 8, count += 8)
+         {
+            __m256 dr = _mm256_sub_ps(_mm256_loadu_ps(r + j), red);
+            __m256 dg = _mm256_sub_ps(_mm256_loadu_ps(g + j), green);
+            __m256 db = _mm256_sub_ps(_mm256_loadu_ps(b + j), blue);
+            __m256 squared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dr, dr), _mm256_mul_ps(dg, dg)), _mm256_mul_ps(db, db));
+            minSquared = _mm256_min_ps(minSquared, squared);
+            maxSquared = _mm256_max_ps(maxSquared, squared);
+            _mm256_store_pd(distances + count, _mm256_sqrt_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(squared))));
+            _mm256_store_pd(distances + count + 4, _mm256_sqrt_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(squared, 1))));
+         }
+         if (j < blockEnd)
+         {
+            // Masked tail, calling scalar SSE code here would pay AVX/SSE
+            // transition stalls on every pair
+            size_t remaining = blockEnd - j;
+            __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(int(remaining)), laneIndex);
+            __m256 valid = _mm256_castsi256_ps(mask);
+            __m256 dr = _mm256_sub_ps(_mm256_maskload_ps(r + j, mask), red);
+            __m256 dg = _mm256_sub_ps(_mm256_maskload_ps(g + j, mask), green);
+            __m256 db = _mm256_sub_ps(_mm256_maskload_ps(b + j, mask), blue);
+            __m256 squared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dr, dr), _mm256_mul_ps(dg, dg)), _mm256_mul_ps(db, db));
+            minSquared = _mm256_min_ps(minSquared, _mm256_blendv_ps(noMinimum, squared, valid));
+            maxSquared = _mm256_max_ps(maxSquared, _mm256_and_ps(squared, valid));
+            _mm256_store_pd(distances + count, _mm256_sqrt_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(squared))));
+            _mm256_store_pd(distances + count + 4, _mm256_sqrt_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(squared, 1))));
+            count += remaining;
+            j = blockEnd;
+         }
+
+         for (size_t k = 0; k < count; k++) { sum += distances[k]; }
+         stats.m_Pairs += count;
+      }
+   }
+
+   alignas(32) float lanes[8];
+   _mm256_store_ps(lanes, minSquared);
+   stats.m_MinSquared = std::min(stats.m_MinSquared, double(*std::min_element(lanes, lanes + 8)));
+   _mm256_store_ps(lanes, maxSquared);
+   stats.m_MaxSquared = std::max(stats.m_MaxSquared, double(*std::max_element(lanes, lanes + 8)));
+   stats.m_Sum = sum;
+}
+#endif
+
+// Dispatch
+void Encode(const double* linear, unsigned char* channels, size_t count)
+{
+#ifdef COLOR_SIMD_X86
+   if (HasAvx2()) { EncodeAvx2(linear, channels, count); }
+   else { EncodeSse2(linear, channels, count); }
+#else
+   EncodeScalar(linear, channels, 0, count);
+#endif
+}
+void SelectColors(const unsigned char* first, const unsigned char* second, const uint64_t* bits,
+                  unsigned char* out, size_t colors)
+{
+#ifdef COLOR_SIMD_X86
+   SelectColorsSse2(first, second, bits, out, colors);
+#else
+   SelectColorsScalar(first, second, bits, out, 0, colors);
+#endif
+}
+void BlendBytes(const unsigned char* first, const unsigned char* second, unsigned weight,
+                unsigned char* out, size_t count)
+{
+#ifdef COLOR_SIMD_X86
+   BlendBytesSse2(first, second, weight, out, count);
+#else
+   BlendBytesScalar(first, second, weight, out, 0, count);
+#endif
+}
+void AddSaturated(unsigned char* bytes, const signed char* deltas, size_t count)
+{
+#ifdef COLOR_SIMD_X86
+   AddSaturatedSse2(bytes, deltas, count);
+#else
+   AddSaturatedScalar(bytes, deltas, 0, count);
+#endif
+}
+void PairDistances(const float* r, const float* g, const float* b,
+                   size_t rowBegin, size_t rowEnd, size_t columnBegin, size_t columnEnd, PairStats& stats)
+{
+#ifdef COLOR_SIMD_X86
+   if (HasAvx2()) { PairDistancesAvx2(r, g, b, rowBegin, rowEnd, columnBegin, columnEnd, stats); }
+   else { PairDistancesSse2(r, g, b, rowBegin, rowEnd, columnBegin, columnEnd, stats); }
+#else
+   PairDistancesScalar(r, g, b, rowBegin, rowEnd, columnBegin, columnEnd, stats);
+#endif
+}
+
+}
+}
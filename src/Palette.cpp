@@ -1,5 +1,11 @@
 #include "Palette.h"
 #include "Data.h"
+#include "PaletteChannels.h"
+#include "ColorCoverage.h"
+#include "ColorGrid.h"
+#include "Perceptual.h"
+#include "ThreadPool.h"
+#include "SimulationLUT.h"
 
 // need to include glew.h before any other opengl
 // need to define GLEW_STATIC
@@ -12,6 +18,9 @@
 #include <cstdlib>
 #include <cfloat>
 #include <algorithm>
+#include <functional>
+#include <cstring>
+#include <memory>
 
 template<typename T>
 constexpr size_t size(const T&) noexcept {
@@ -23,15 +32,137 @@ namespace color {
 // Color
 double Color::Distance(const Color& other) const
 {
-   double distance = sqrt(pow(abs(int(r - other.r)), 2) + pow(abs(int(g - other.g)), 2) + pow(abs(int(b - other.b)), 2));
+   int dr = int(r) - int(other.r);
+   int dg = int(g) - int(other.g);
+   int db = int(b) - int(other.b);
+   double distance = sqrt(double(dr * dr + dg * dg + db * db));
    return distance;
 }
 void Color::Print() const
 {
-   std::cout << "(" << r << ", " << g << ", " << b << ")";
+   std::cout << "(" << int(r) << ", " << int(g) << ", " << int(b) << ")";
 }
 
 // Palette
+static uint32_t SquaredDistance(const Color& a, const Color& b)
+{
+   int dr = int(a.r) - int(b.r);
+   int dg = int(a.g) - int(b.g);
+   int db = int(a.b) - int(b.b);
+   return uint32_t(dr * dr + dg * dg + db * db);
+}
+
+// Palettes at least this large split their pairs into square tiles that run
+// on a thread pool. One tile's two channel blocks take 6KB, well inside L1.
+// Both the cutoff and the tiling depend on the palette size alone, so the
+// same palette always takes the same path.
+static const size_t PARALLEL_EVALUATION_SIZE = 2048;
+// CIEDE2000 pairs cost about as much as a small RGB tile row
+static const size_t PARALLEL_DELTA_E2000_SIZE = 512;
+static const size_t EVALUATION_TILE_SIZE = 256;
+
+// Tile sums added up a fixed binary tree whose shape depends only on the
+// number of tiles, never on which thread finished first
+static double PairwiseSum(const kernels::PairStats* partials, size_t count)
+{
+   if (count <= 1)
+   {
+      return count == 1 ? partials[0].m_Sum : 0.0;
+   }
+   size_t half = count / 2;
+   return PairwiseSum(partials, half) + PairwiseSum(partials + half, count - half);
+}
+using PairFunction = void (*)(const float* x, const float* y, const float* z, size_t rowBegin, size_t rowEnd,
+                              size_t columnBegin, size_t columnEnd, kernels::PairStats& stats);
+
+// CIE76 and Oklab are plain Euclidean distances in their space, the same
+// kernel as RGB
+static PairFunction PairFunctionFor(DistanceMetric metric)
+{
+   return metric == DistanceMetric::CIE2000 ? perceptual::DeltaE2000Pairs : kernels::PairDistances;
+}
+static size_t ParallelSizeFor(DistanceMetric metric)
+{
+   return metric == DistanceMetric::CIE2000 ? PARALLEL_DELTA_E2000_SIZE : PARALLEL_EVALUATION_SIZE;
+}
+
+// Pair statistics for several channel sets of the same size, such as one
+// palette under several blindness types. Each tile, or each block of rows
+// on the serial path, runs for every set back to back while its colors are
+// still in cache. A set's result does not depend on how many run with it.
+static void PairDistanceStats(const PaletteChannels<float>* channels, size_t sets, DistanceMetric metric,
+                              ThreadPool& pool, kernels::PairStats* stats)
+{
+   PairFunction pairDistances = PairFunctionFor(metric);
+   size_t colors = channels[0].Size();
+   if (colors < ParallelSizeFor(metric))
+   {
+      // Rows run in order, so each sum keeps its row-major pair order
+      const size_t ROW_BLOCK = 32;
+      for (size_t row = 0; row < colors; row += ROW_BLOCK)
+      {
+         for (size_t set = 0; set < sets; set++)
+         {
+            pairDistances(channels[set].R(), channels[set].G(), channels[set].B(),
+                          row, std::min(row + ROW_BLOCK, colors), 0, colors, stats[set]);
+         }
+      }
+      return;
+   }
+
+   // Kept per thread so repeated evaluations reuse the allocations. Tile
+   // tasks never evaluate, so the calling thread does not reenter this.
+   // Workers see their own thread_locals, so the tasks go through references.
+   static thread_local std::vector<std::pair<size_t, size_t>> tileScratch;
+   static thread_local std::vector<kernels::PairStats> partialScratch;
+   std::vector<std::pair<size_t, size_t>>& tiles = tileScratch;
+   std::vector<kernels::PairStats>& partials = partialScratch;
+
+   size_t blocks = (colors + EVALUATION_TILE_SIZE - 1) / EVALUATION_TILE_SIZE;
+   tiles.clear();
+   for (size_t row = 0; row < blocks; row++)
+   {
+      for (size_t column = row; column < blocks; column++)
+      {
+         tiles.emplace_back(row * EVALUATION_TILE_SIZE, column * EVALUATION_TILE_SIZE);
+      }
+   }
+
+   partials.assign(tiles.size() * sets, kernels::PairStats());
+   auto tile = [&](size_t index)
+   {
+      size_t row = tiles[index].first;
+      size_t column = tiles[index].second;
+      for (size_t set = 0; set < sets; set++)
+      {
+         pairDistances(channels[set].R(), channels[set].G(), channels[set].B(),
+                       row, std::min(row + EVALUATION_TILE_SIZE, colors),
+                       column, std::min(column + EVALUATION_TILE_SIZE, colors), partials[set * tiles.size() + index]);
+      }
+   };
+   pool.ParallelFor(tiles.size(), tile);
+
+   // Min, max and the pair count are exact, only the sum cares about order
+   for (size_t set = 0; set < sets; set++)
+   {
+      const kernels::PairStats* setPartials = partials.data() + set * tiles.size();
+      for (size_t index = 0; index < tiles.size(); index++)
+      {
+         stats[set].Merge(setPartials[index]);
+      }
+      stats[set].m_Sum = PairwiseSum(setPartials, tiles.size());
+   }
+}
+void MultiTypeEvaluation::Print() const
+{
+   for (size_t type = 0; type < BlindnessType::LAST; type++)
+   {
+      std::cout << BlindnessTypeNames.at(static_cast<BlindnessType>(type)) << std::endl;
+      m_Types[type].Print();
+   }
+   std::cout << "Worst Case" << std::endl;
+   m_WorstCase.Print();
+}
 void Palette::Print(bool colors) const
 {
    std::cout << "Palette: " << m_Name << std::endl;
@@ -45,48 +176,354 @@ void Palette::Print(bool colors) const
       }
    }
 }
-void Palette::Evaluate()
+void Palette::AddColor(const Color& color)
 {
-   // Calculate the maximum possible color distance
-   const double maxColorDistance = sqrt(pow(255, 2) * 3);
+   size_t index = m_Colors.size();
+   m_Colors.push_back(color);
+   if (!IsIncremental())
+   {
+      return;
+   }
 
-   m_Evaluation.m_MinDistance = DBL_MAX;
-   m_Evaluation.m_MaxDistance = 0;
-   m_Evaluation.m_ColorRepresentation = 0;
+   // The new color's pairs are one more row at the end of the triangle
+   m_Distances.m_Squared.resize(m_Distances.m_Squared.size() + index);
+   uint32_t* row = m_Distances.m_Squared.data() + index * (index - 1) / 2;
+   double delta = 0;
+   for (size_t j = 0; j < index; j++)
+   {
+      row[j] = SquaredDistance(color, m_Colors[j]);
+      m_Distances.Add(row[j]);
+      delta += sqrt(double(row[j]));
+   }
+   m_Distances.AddToSum(delta);
+   SetEvaluation(m_Distances.Sum(), m_Distances.m_MinSquared, m_Distances.m_MaxSquared);
+}
+void Palette::SetColor(size_t index, const Color& color)
+{
+   if (m_Colors[index] == color)
+   {
+      return;
+   }
 
-   double sumDistance = 0;
-   for (auto color = m_Colors.begin(); color != m_Colors.end(); color++)
+   // Stored before scoring, the coverage term reads the colors themselves
+   m_Colors[index] = color;
+   if (IsIncremental())
+   {
+      if (!UpdateDistances(index))
+      {
+         RescanDistances();
+      }
+      SetEvaluation(m_Distances.Sum(), m_Distances.m_MinSquared, m_Distances.m_MaxSquared);
+   }
+}
+void Palette::SetColors(const size_t* indices, const Color* colors, size_t count)
+{
+   if (!IsIncremental() || count * 4 > m_Colors.size())
    {
-      for (auto otherColor = std::next(color); otherColor != m_Colors.end(); otherColor++)
+      for (size_t i = 0; i < count; i++)
+      {
+         m_Colors[indices[i]] = colors[i];
+      }
+      if (IsIncremental())
       {
-         double distance = color->Distance(*otherColor);
-         sumDistance += distance;
-         if (distance < m_Evaluation.m_MinDistance) { m_Evaluation.m_MinDistance = distance; }
-         if (distance > m_Evaluation.m_MaxDistance) { m_Evaluation.m_MaxDistance = distance; }
+         Evaluate();
       }
+      return;
    }
 
+   // Min and max only need one rescan however many updates lost them
+   bool valid = true, changed = false;
+   for (size_t i = 0; i < count; i++)
+   {
+      if (m_Colors[indices[i]] == colors[i])
+      {
+         continue;
+      }
+      m_Colors[indices[i]] = colors[i];
+      valid = UpdateDistances(indices[i]) && valid;
+      changed = true;
+   }
+   if (!changed)
+   {
+      return;
+   }
+   if (!valid)
+   {
+      RescanDistances();
+   }
+   SetEvaluation(m_Distances.Sum(), m_Distances.m_MinSquared, m_Distances.m_MaxSquared);
+}
+void Palette::EnableIncrementalEvaluation()
+{
+   m_Distances.m_Enabled = true;
+   Evaluate();
+}
+void Palette::DisableIncrementalEvaluation()
+{
+   m_Distances = DistanceState();
+}
+void Palette::Evaluate()
+{
+   Evaluate(ThreadPool::Shared());
+}
+void Palette::Evaluate(ThreadPool& pool)
+{
+   // Colors go to the metric's space once, then the pair loop runs as a
+   // kernel over structure-of-arrays channels
+   static thread_local PaletteChannels<float> channels;
+   if (m_Metric == DistanceMetric::RGB)
+   {
+      channels.Assign(*this);
+   }
+   else
+   {
+      channels.Resize(m_Colors.size());
+      perceptual::Assign(m_Colors.data(), m_Colors.size(), m_Metric, channels.R(), channels.G(), channels.B());
+   }
+
+   kernels::PairStats stats;
+   PairDistanceStats(&channels, 1, m_Metric, pool, &stats);
+
+   if (IsIncremental())
+   {
+      BuildDistances(stats.m_Sum);
+   }
+   SetEvaluation(stats.m_Sum, stats.m_MinSquared, stats.m_MaxSquared);
+}
+double Palette::MinDistance() const
+{
+   uint32_t squared = ColorGrid(*this).ClosestPair();
+   return squared == UINT32_MAX ? DBL_MAX : sqrt(double(squared));
+}
+void Palette::NearestDistances(std::vector<double>& distances) const
+{
+   std::vector<uint32_t> squared;
+   ColorGrid(*this).NearestSquared(squared);
+   distances.resize(squared.size());
+   for (size_t i = 0; i < squared.size(); i++)
+   {
+      distances[i] = squared[i] == UINT32_MAX ? DBL_MAX : sqrt(double(squared[i]));
+   }
+}
+void Palette::EvaluateAllTypes(MultiTypeEvaluation& evaluation) const
+{
+   EvaluateAllTypes(evaluation, ThreadPool::Shared());
+}
+void Palette::EvaluateAllTypes(MultiTypeEvaluation& evaluation, ThreadPool& pool) const
+{
+   static thread_local std::vector<Color> converted[BlindnessType::LAST];
+   static thread_local PaletteChannels<float> channels[BlindnessType::LAST];
+
    size_t paletteSize = m_Colors.size();
+   Color* outputs[BlindnessType::LAST];
+   for (size_t type = 0; type < BlindnessType::LAST; type++)
+   {
+      converted[type].resize(paletteSize);
+      channels[type].Resize(paletteSize);
+      outputs[type] = converted[type].data();
+   }
+
+   // Convert a tile's worth of colors to every type and straight into that
+   // type's channels while it is still in cache
+   for (size_t begin = 0; begin < paletteSize; begin += EVALUATION_TILE_SIZE)
+   {
+      size_t count = std::min(EVALUATION_TILE_SIZE, paletteSize - begin);
+      Color* blockOutputs[BlindnessType::LAST];
+      for (size_t type = 0; type < BlindnessType::LAST; type++)
+      {
+         blockOutputs[type] = outputs[type] + begin;
+      }
+      Converter::ConvertAllTypes(m_Colors.data() + begin, count, blockOutputs);
+      for (size_t type = 0; type < BlindnessType::LAST; type++)
+      {
+         perceptual::Assign(blockOutputs[type], count, m_Metric,
+                            channels[type].R() + begin, channels[type].G() + begin, channels[type].B() + begin);
+      }
+   }
+
+   kernels::PairStats stats[BlindnessType::LAST];
+   PairDistanceStats(channels, BlindnessType::LAST, m_Metric, pool, stats);
+
+   for (size_t type = 0; type < BlindnessType::LAST; type++)
+   {
+      Score(evaluation.m_Types[type], converted[type].data(), paletteSize, m_Metric,
+            stats[type].m_Sum, stats[type].m_MinSquared, stats[type].m_MaxSquared);
+   }
+   evaluation.m_WorstCase = evaluation.m_Types[0];
+   for (size_t type = 1; type < BlindnessType::LAST; type++)
+   {
+      const PaletteEvaluation& typeEvaluation = evaluation.m_Types[type];
+      PaletteEvaluation& worst = evaluation.m_WorstCase;
+      worst.m_AverageDistance = std::min(worst.m_AverageDistance, typeEvaluation.m_AverageDistance);
+      worst.m_MinDistance = std::min(worst.m_MinDistance, typeEvaluation.m_MinDistance);
+      worst.m_MaxDistance = std::min(worst.m_MaxDistance, typeEvaluation.m_MaxDistance);
+      worst.m_ColorRepresentation = std::min(worst.m_ColorRepresentation, typeEvaluation.m_ColorRepresentation);
+      worst.m_TotalEvaluation = std::min(worst.m_TotalEvaluation, typeEvaluation.m_TotalEvaluation);
+   }
+}
+void Palette::EvaluateSets(const Color* colors, size_t sets, size_t paletteSize, DistanceMetric metric,
+                           PaletteEvaluation* evaluations, ThreadPool& pool)
+{
+   static thread_local std::vector<PaletteChannels<float>> channels;
+   static thread_local std::vector<kernels::PairStats> stats;
+   if (channels.size() < sets)
+   {
+      channels.resize(sets);
+   }
+   for (size_t set = 0; set < sets; set++)
+   {
+      channels[set].Resize(paletteSize);
+      perceptual::Assign(colors + set * paletteSize, paletteSize, metric, channels[set].R(), channels[set].G(), channels[set].B());
+   }
+
+   stats.assign(sets, kernels::PairStats());
+   PairDistanceStats(channels.data(), sets, metric, pool, stats.data());
+   for (size_t set = 0; set < sets; set++)
+   {
+      Score(evaluations[set], colors + set * paletteSize, paletteSize, metric,
+            stats[set].m_Sum, stats[set].m_MinSquared, stats[set].m_MaxSquared);
+   }
+}
+void Palette::SetEvaluation(double sumDistance, double minSquared, double maxSquared)
+{
+   Score(m_Evaluation, m_Colors.data(), m_Colors.size(), m_Metric, sumDistance, minSquared, maxSquared);
+}
+void Palette::Score(PaletteEvaluation& evaluation, const Color* colors, size_t paletteSize, DistanceMetric metric,
+                    double sumDistance, double minSquared, double maxSquared)
+{
+   // Calculate the maximum possible color distance
+   const double maxColorDistance = PerceptualTables::Get().MaxDistance(metric);
+
+   evaluation.m_MinDistance = paletteSize > 1 ? sqrt(minSquared) : DBL_MAX;
+   evaluation.m_MaxDistance = paletteSize > 1 ? sqrt(maxSquared) : 0;
+
    if (paletteSize > 1) {
-      m_Evaluation.m_AverageDistance = sumDistance / (paletteSize * (paletteSize - 1) / 2);
+      evaluation.m_AverageDistance = sumDistance / (paletteSize * (paletteSize - 1) / 2);
    }
    else {
-      m_Evaluation.m_AverageDistance = 0; // or another appropriate value for palettes with 0 or 1 color
+      evaluation.m_AverageDistance = 0; // or another appropriate value for palettes with 0 or 1 color
    }
 
    // Normalize distances
-   m_Evaluation.m_MinDistance /= maxColorDistance;
-   m_Evaluation.m_MaxDistance /= maxColorDistance;
-   m_Evaluation.m_AverageDistance /= maxColorDistance;
+   evaluation.m_MinDistance /= maxColorDistance;
+   evaluation.m_MaxDistance /= maxColorDistance;
+   evaluation.m_AverageDistance /= maxColorDistance;
+
+   // Share of the RGB cube within one 16^3 bin of some color, O(n) per call
+   evaluation.m_ColorRepresentation = ColorCoverage::Representation(colors, paletteSize);
 
    // Calculate the total evaluation
    const double weightMinDistance = 1.0; // Adjust these weights as needed
    const double weightMaxDistance = 1.0;
    const double weightAverageDistance = 1.0;
+   const double weightColorRepresentation = 1.0;
+
+   evaluation.m_TotalEvaluation = (weightMinDistance * evaluation.m_MinDistance) +
+      (weightMaxDistance * evaluation.m_MaxDistance) +
+      (weightAverageDistance * evaluation.m_AverageDistance) +
+      (weightColorRepresentation * evaluation.m_ColorRepresentation);
+}
+void Palette::BuildDistances(double sumDistance)
+{
+   size_t paletteSize = m_Colors.size();
+   m_Distances.m_Squared.resize(paletteSize > 1 ? paletteSize * (paletteSize - 1) / 2 : 0);
+   uint32_t* squared = m_Distances.m_Squared.data();
+   for (size_t i = 1; i < paletteSize; i++)
+   {
+      for (size_t j = 0; j < i; j++)
+      {
+         *squared++ = SquaredDistance(m_Colors[i], m_Colors[j]);
+      }
+   }
+   m_Distances.m_Sum = sumDistance;
+   m_Distances.m_Compensation = 0;
+   RescanDistances();
+}
+void Palette::RescanDistances()
+{
+   m_Distances.m_MinCount = 0;
+   m_Distances.m_MaxCount = 0;
+   for (uint32_t squared : m_Distances.m_Squared)
+   {
+      m_Distances.Add(squared);
+   }
+}
+bool Palette::UpdateDistances(size_t index)
+{
+   // Row index holds pairs with every earlier color, the column below it
+   // pairs with every later one at a growing stride
+   uint32_t* squared = m_Distances.m_Squared.data();
+   size_t paletteSize = m_Colors.size();
+   size_t offset = index * (index - 1) / 2;
+   const Color color = m_Colors[index];
+   bool valid = true;
+   double delta = 0;
+   for (size_t j = 0; j < paletteSize; j++)
+   {
+      if (j == index)
+      {
+         offset = index * (index + 1) / 2 + index;
+         continue;
+      }
+      uint32_t updated = SquaredDistance(color, m_Colors[j]);
+      uint32_t& pair = squared[offset];
+      valid = m_Distances.Remove(pair) && valid;
+      m_Distances.Add(updated);
+      delta += sqrt(double(updated)) - sqrt(double(pair));
+      pair = updated;
+      offset += j < index ? 1 : j;
+   }
+   m_Distances.AddToSum(delta);
 
-   m_Evaluation.m_TotalEvaluation = (weightMinDistance * m_Evaluation.m_MinDistance) +
-      (weightMaxDistance * m_Evaluation.m_MaxDistance) +
-      (weightAverageDistance * m_Evaluation.m_AverageDistance);
+   // Lost the only pair at an extreme, the caller has to find the next one
+   return valid;
+}
+void Palette::DistanceState::Add(uint32_t squared)
+{
+   if (m_MinCount == 0 || squared < m_MinSquared)
+   {
+      m_MinSquared = squared;
+      m_MinCount = 1;
+   }
+   else if (squared == m_MinSquared)
+   {
+      m_MinCount++;
+   }
+   if (m_MaxCount == 0 || squared > m_MaxSquared)
+   {
+      m_MaxSquared = squared;
+      m_MaxCount = 1;
+   }
+   else if (squared == m_MaxSquared)
+   {
+      m_MaxCount++;
+   }
+}
+bool Palette::DistanceState::Remove(uint32_t squared)
+{
+   if (squared == m_MinSquared && m_MinCount > 0)
+   {
+      m_MinCount--;
+   }
+   if (squared == m_MaxSquared && m_MaxCount > 0)
+   {
+      m_MaxCount--;
+   }
+   return m_MinCount > 0 && m_MaxCount > 0;
+}
+void Palette::DistanceState::AddToSum(double value)
+{
+   // Neumaier summation, the deltas are small against a large running sum
+   double sum = m_Sum + value;
+   if (fabs(m_Sum) >= fabs(value))
+   {
+      m_Compensation += (m_Sum - sum) + value;
+   }
+   else
+   {
+      m_Compensation += (value - sum) + m_Sum;
+   }
+   m_Sum = sum;
 }
 void Palette::Draw() const
 {
@@ -179,110 +616,224 @@ void Palette::AppendToDrawing(size_t offsetX, size_t offsetY) const
 }
 
 // Converter
-Color Converter::ConvertColor(const Color& color, const BlindnessType& type)
+static const Converter::ConvertFunction CONVERT_FUNCTIONS[BlindnessType::LAST + 1] =
+{
+   &Converter::Convert<BlindnessType::NORMAL>,
+   &Converter::Convert<BlindnessType::DEUTERANOPIA>,
+   &Converter::Convert<BlindnessType::PROTANOPIA>,
+   &Converter::Convert<BlindnessType::TRITANOPIA>,
+   &Converter::Convert<BlindnessType::DEUTERANOMALY>,
+   &Converter::Convert<BlindnessType::PROTANOMALY>,
+   &Converter::Convert<BlindnessType::TRITANOMALY>,
+   &Converter::Convert<BlindnessType::LAST>
+};
+static const Converter::ConvertColorsFunction CONVERT_COLORS_FUNCTIONS[BlindnessType::LAST + 1] =
 {
-   if (type == BlindnessType::NORMAL) { return color; }
+   &Converter::ConvertColors<BlindnessType::NORMAL>,
+   &Converter::ConvertColors<BlindnessType::DEUTERANOPIA>,
+   &Converter::ConvertColors<BlindnessType::PROTANOPIA>,
+   &Converter::ConvertColors<BlindnessType::TRITANOPIA>,
+   &Converter::ConvertColors<BlindnessType::DEUTERANOMALY>,
+   &Converter::ConvertColors<BlindnessType::PROTANOMALY>,
+   &Converter::ConvertColors<BlindnessType::TRITANOMALY>,
+   &Converter::ConvertColors<BlindnessType::LAST>
+};
 
-   double linearR, linearG, linearB;
-   Converter::StandardToLinear(color, &linearR, &linearG, &linearB);
-   double convertedLinearR, convertedLinearG, convertedLinearB;
+// Set by EnableSimulationLUT. The LUT trampolines fall back to the matrix path
+// if it is disabled after a caller picked one up.
+static std::unique_ptr<SimulationLUT> s_SimulationLUT;
 
-   switch (type)
-   {
-   case BlindnessType::PROTANOPIA:
-   {
-      Converter::ApplyMatrix(PROTANOPIA_MATRIX, linearR, linearG, linearB,
-                             &convertedLinearR, &convertedLinearG, &convertedLinearB);
-      break;
-   }
-   case BlindnessType::DEUTERANOPIA:
-   {
-      Converter::ApplyMatrix(DEUTERANOPIA_MATRIX, linearR, linearG, linearB,
-                             &convertedLinearR, &convertedLinearG, &convertedLinearB);
-      break;
-   }
-   case BlindnessType::TRITANOPIA:
+template <BlindnessType T>
+static Color ConvertWithLUT(const Color& color)
+{
+   const SimulationLUT* lut = s_SimulationLUT.get();
+   return lut ? lut->Convert(color, T) : Converter::Convert<T>(color);
+}
+template <BlindnessType T>
+static void ConvertColorsWithLUT(const Color* colors, size_t count, Color* converted)
+{
+   const SimulationLUT* lut = s_SimulationLUT.get();
+   if (lut) { lut->ConvertColors(colors, count, T, converted); }
+   else { Converter::ConvertColors<T>(colors, count, converted); }
+}
+static const Converter::ConvertFunction CONVERT_LUT_FUNCTIONS[BlindnessType::LAST + 1] =
+{
+   &ConvertWithLUT<BlindnessType::NORMAL>,
+   &ConvertWithLUT<BlindnessType::DEUTERANOPIA>,
+   &ConvertWithLUT<BlindnessType::PROTANOPIA>,
+   &ConvertWithLUT<BlindnessType::TRITANOPIA>,
+   &ConvertWithLUT<BlindnessType::DEUTERANOMALY>,
+   &ConvertWithLUT<BlindnessType::PROTANOMALY>,
+   &ConvertWithLUT<BlindnessType::TRITANOMALY>,
+   &ConvertWithLUT<BlindnessType::LAST>
+};
+static const Converter::ConvertColorsFunction CONVERT_COLORS_LUT_FUNCTIONS[BlindnessType::LAST + 1] =
+{
+   &ConvertColorsWithLUT<BlindnessType::NORMAL>,
+   &ConvertColorsWithLUT<BlindnessType::DEUTERANOPIA>,
+   &ConvertColorsWithLUT<BlindnessType::PROTANOPIA>,
+   &ConvertColorsWithLUT<BlindnessType::TRITANOPIA>,
+   &ConvertColorsWithLUT<BlindnessType::DEUTERANOMALY>,
+   &ConvertColorsWithLUT<BlindnessType::PROTANOMALY>,
+   &ConvertColorsWithLUT<BlindnessType::TRITANOMALY>,
+   &ConvertColorsWithLUT<BlindnessType::LAST>
+};
+
+// The simulation matrices of every type but NORMAL stacked into one
+// 18x3 block, so all of them apply in a single product
+static const size_t SIMULATED_TYPES = BlindnessType::LAST - 1;
+struct SimulationBlock
+{
+   double m_Values[SIMULATED_TYPES * 9];
+};
+static constexpr SimulationBlock BuildSimulationBlock()
+{
+   SimulationBlock block{};
+   for (size_t type = 0; type < SIMULATED_TYPES; type++)
    {
-      Converter::ApplyMatrix(TRITANOPIA_MATRIX, linearR, linearG, linearB,
-                             &convertedLinearR, &convertedLinearG, &convertedLinearB);
-      break;
+      const double* matrix = Converter::SimulationMatrix(static_cast<BlindnessType>(type + 1));
+      for (size_t i = 0; i < 9; i++)
+      {
+         block.m_Values[type * 9 + i] = matrix[i];
+      }
    }
-   case BlindnessType::DEUTERANOMALY:
+   return block;
+}
+static constexpr SimulationBlock SIMULATION_BLOCK = BuildSimulationBlock();
+
+Color Converter::ConvertColor(const Color& color, const BlindnessType& type)
+{
+   return GetConvertFunction(type)(color);
+}
+void Converter::ConvertPalette(const Palette& palette, const BlindnessType& type, Palette& converted)
+{
+   converted.m_Colors.resize(palette.m_Colors.size());
+   ConvertColors(palette.m_Colors.data(), palette.m_Colors.size(), type, converted.m_Colors.data());
+}
+void Converter::ConvertColors(const Color* colors, size_t count, const BlindnessType& type, Color* converted)
+{
+   GetConvertColorsFunction(type)(colors, count, converted);
+}
+void Converter::ConvertAllTypes(const Palette& palette, std::vector<Palette>& converted)
+{
+   // Reuse the output palettes from a previous call when there are any
+   converted.resize(BlindnessType::LAST, Palette(""));
+   Color* outputs[BlindnessType::LAST];
+   for (size_t i = 0; i < BlindnessType::LAST; i++)
    {
-      Converter::ApplyMatrix(DEUTERANOMALY_MATRIX, linearR, linearG, linearB,
-                             &convertedLinearR, &convertedLinearG, &convertedLinearB);      
-      break;
+      converted[i].m_Name = BlindnessTypeNames.at(static_cast<BlindnessType>(i));
+      converted[i].m_Evaluation = Palette::PaletteEvaluation();
+      converted[i].m_Colors.resize(palette.m_Colors.size());
+      outputs[i] = converted[i].m_Colors.data();
    }
-   case BlindnessType::PROTANOMALY:
+   ConvertAllTypes(palette.m_Colors.data(), palette.m_Colors.size(), outputs);
+}
+void Converter::ConvertAllTypes(const Color* colors, size_t count, Color* const converted[])
+{
+   if (const SimulationLUT* lut = s_SimulationLUT.get())
    {
-      Converter::ApplyMatrix(PROTANOMALY_MATRIX, linearR, linearG, linearB,
-                             &convertedLinearR, &convertedLinearG, &convertedLinearB);      
-      break;
+      for (size_t type = 0; type < BlindnessType::LAST; type++)
+      {
+         lut->ConvertColors(colors, count, static_cast<BlindnessType>(type), converted[type]);
+      }
+      return;
    }
-   case BlindnessType::TRITANOMALY:
+
+   const double* decode = SrgbTables::Get().m_Decode;
+   const double* block = SIMULATION_BLOCK.m_Values;
+
+   // One structure-of-arrays chunk of decoded colors feeds all 18 output rows
+   const size_t CHUNK_SIZE = 64;
+   const size_t ROWS = SIMULATED_TYPES * 3;
+   alignas(32) double r[CHUNK_SIZE] = {}, g[CHUNK_SIZE] = {}, b[CHUNK_SIZE] = {};
+   alignas(32) double linear[ROWS][CHUNK_SIZE];
+   unsigned char standard[ROWS][CHUNK_SIZE];
+
+   for (size_t begin = 0; begin < count; begin += CHUNK_SIZE)
    {
-      Converter::ApplyMatrix(TRITANOMALY_MATRIX, linearR, linearG, linearB,
-                             &convertedLinearR, &convertedLinearG, &convertedLinearB);      
-      break;
+      size_t chunk = std::min(CHUNK_SIZE, count - begin);
+      for (size_t i = 0; i < chunk; i++)
+      {
+         const Color& color = colors[begin + i];
+         r[i] = decode[color.r];
+         g[i] = decode[color.g];
+         b[i] = decode[color.b];
+      }
+
+      // Same operation order as the single-type path, so results match it
+      for (size_t row = 0; row < ROWS; row++)
+      {
+         const double* coefficients = block + row * 3;
+         for (size_t i = 0; i < CHUNK_SIZE; i++)
+         {
+            linear[row][i] = coefficients[0]*r[i] + coefficients[1]*g[i] + coefficients[2]*b[i];
+         }
+         kernels::Encode(linear[row], standard[row], chunk);
+      }
+
+      if (converted[BlindnessType::NORMAL] != colors)
+      {
+         std::copy(colors + begin, colors + begin + chunk, converted[BlindnessType::NORMAL] + begin);
+      }
+      for (size_t type = 0; type < SIMULATED_TYPES; type++)
+      {
+         Color* output = converted[type + 1] + begin;
+         const unsigned char* standardR = standard[type * 3];
+         const unsigned char* standardG = standard[type * 3 + 1];
+         const unsigned char* standardB = standard[type * 3 + 2];
+         for (size_t i = 0; i < chunk; i++)
+         {
+            output[i] = Color(standardR[i], standardG[i], standardB[i]);
+         }
+      }
    }
-   
-   default:
+}
+Converter::ConvertFunction Converter::GetConvertFunction(const BlindnessType& type)
+{
+   // Anything past the last type converts through the identity matrix
+   const ConvertFunction* functions = s_SimulationLUT ? CONVERT_LUT_FUNCTIONS : CONVERT_FUNCTIONS;
+   return functions[std::min(type, BlindnessType::LAST)];
+}
+Converter::ConvertColorsFunction Converter::GetConvertColorsFunction(const BlindnessType& type)
+{
+   const ConvertColorsFunction* functions = s_SimulationLUT ? CONVERT_COLORS_LUT_FUNCTIONS : CONVERT_COLORS_FUNCTIONS;
+   return functions[std::min(type, BlindnessType::LAST)];
+}
+const SimulationLUT& Converter::EnableSimulationLUT(size_t gridSize, const std::string& cachePath)
+{
+   if (!s_SimulationLUT || s_SimulationLUT->GridSize() != std::max<size_t>(gridSize, 2))
    {
-      convertedLinearR = linearR;
-      convertedLinearG = linearG;
-      convertedLinearB = linearB;
-      break;
+      s_SimulationLUT = std::make_unique<SimulationLUT>(gridSize, cachePath);
    }
-   }
-
-   Color convert;
-   Converter::LinearToStandard(convertedLinearR, convertedLinearG, convertedLinearB, &convert);
-
-   return convert;
+   return *s_SimulationLUT;
+}
+void Converter::DisableSimulationLUT()
+{
+   s_SimulationLUT.reset();
+}
+const SimulationLUT* Converter::GetSimulationLUT()
+{
+   return s_SimulationLUT.get();
+}
+Color Converter::ConvertColorExact(const Color& color, const BlindnessType& type)
+{
+   return CONVERT_FUNCTIONS[std::min(type, BlindnessType::LAST)](color);
 }
 void Converter::StandardToLinear(const Color& standard, double* r, double* g, double* b)
 {
-   // Convert RGB values to the 0-1 range
-   double R_ = standard.r / 255.0;
-   double G_ = standard.g / 255.0;
-   double B_ = standard.b / 255.0;
-
-   // Apply gamma correction to the RGB values
-   double gamma = 2.2;
-   R_ = pow(R_, gamma);
-   G_ = pow(G_, gamma);
-   B_ = pow(B_, gamma);
-
-   // Convert gamma-corrected RGB values to linear RGB values
-   double a = 0.055;
-   if (R_ <= 0.04045) { *r = R_ / 12.92; } 
-   else { *r = pow((R_ + a) / (1.0 + a), 2.4); }
-
-   if (G_ <= 0.04045) { *g = G_ / 12.92; } 
-   else { *g = pow((G_ + a) / (1.0 + a), 2.4); }
-
-   if (B_ <= 0.04045) { *b = B_ / 12.92; } 
-   else { *b = pow((B_ + a) / (1.0 + a), 2.4); }
+   // Gamma correction and linearization are precomputed per channel value
+   const double* decode = SrgbTables::Get().m_Decode;
+   *r = decode[standard.r];
+   *g = decode[standard.g];
+   *b = decode[standard.b];
 }
 void Converter::LinearToStandard(const double& r, const double& g, const double& b, Color* standard)
 {
-   // Convert linear RGB values to sRGB values
-   double a = 0.055;
-   if (r <= 0.0031308) {
-      standard->r = round(255.0 * r * 12.92);
-   } else {
-      standard->r = round(255.0 * ((1.0 + a) * pow(r, 1.0 / 2.4) - a));
-   }
-   if (g <= 0.0031308) {
-      standard->g = round(255.0 * g * 12.92);
-   } else {
-      standard->g = round(255.0 * ((1.0 + a) * pow(g, 1.0 / 2.4) - a));
-   }
-   if (b <= 0.0031308) {
-      standard->b = round(255.0 * b * 12.92);
-   } else {
-      standard->b = round(255.0 * ((1.0 + a) * pow(b, 1.0 / 2.4) - a));
-   }
+   // Convert linear RGB values to sRGB values, clamped to 0-255
+   const SrgbTables& tables = SrgbTables::Get();
+   standard->r = tables.Encode(r);
+   standard->g = tables.Encode(g);
+   standard->b = tables.Encode(b);
 }
 Color Converter::WavelengthToStandard(double wavelength) 
 {
@@ -338,7 +889,7 @@ Color Converter::WavelengthToStandard(double wavelength)
    g = round(255.0 * (g * factor));
    b = round(255.0 * (b * factor));
 
-   return Color(r, g, b);
+   return Color(uint8_t(r), uint8_t(g), uint8_t(b));
 }
 void Converter::ApplyMatrix(const double matrix[], const double& r, const double g, const double b, 
                             double* convertedR, double* convertedG, double* convertedB)
@@ -504,20 +1055,12 @@ void Palettes::GenerateBlindnessPalettes(const size_t id)
       return;
    }
 
-   auto palette = lookup2->second;
-   const size_t NUM_VALUES = static_cast<size_t>(BlindnessType::LAST);
+   std::vector<Palette> blindPalettes;
+   Converter::ConvertAllTypes(lookup2->second, blindPalettes);
 
-   for (size_t i = 0; i < NUM_VALUES; i++) 
+   for (size_t i = 0; i < blindPalettes.size(); i++)
    {
-      BlindnessType type = static_cast<BlindnessType>(i);
-      Palette blindPalette(BlindnessTypeNames.at(type));
-
-      for (const auto& color : palette.m_Colors)
-      {
-         blindPalette.AddColor(Converter::ConvertColor(color, type));
-      }
-
-      lookup->second.insert({type, blindPalette});
+      lookup->second.insert({static_cast<BlindnessType>(i), blindPalettes[i]});
    }
 }
 void Palettes::EvaluateColorPalettes(const size_t id)
@@ -529,9 +1072,23 @@ void Palettes::EvaluateColorPalettes(const size_t id)
       return;
    }
 
+   auto normal = lookup->second.find(BlindnessType::NORMAL);
+   if (normal == lookup->second.end())
+   {
+      std::cout << "Failed to find palette from id provided" << std::endl;
+      return;
+   }
+
+   // One fused pass scores every type, each result the same as Evaluate
+   MultiTypeEvaluation evaluation;
+   normal->second.EvaluateAllTypes(evaluation);
    for (auto& [type, palette] : lookup->second)
    {
-      palette.Evaluate();
+      // Keys come from GenerateBlindnessPalettes, one per type below LAST
+      if (type < BlindnessType::LAST)
+      {
+         palette.m_Evaluation = evaluation.m_Types[type];
+      }
    }
 }
 size_t Palettes::GenerateAllBlack()
@@ -556,42 +1113,113 @@ size_t Palettes::GenerateVisibleSpectrum()
 }
 
 // Function to generate a random color
-Color GenerateRandomColor() 
+Color GenerateRandomColor(Random& random) 
 {
    // Assuming the range of each color component is 0-255
-   size_t r = rand() % VULCAN_PALETTE_SIZE;
-   size_t g = rand() % VULCAN_PALETTE_SIZE;
-   size_t b = rand() % VULCAN_PALETTE_SIZE;
+   size_t r = random.Uniform(VULCAN_PALETTE_SIZE);
+   size_t g = random.Uniform(VULCAN_PALETTE_SIZE);
+   size_t b = random.Uniform(VULCAN_PALETTE_SIZE);
    return Color(r, g, b);
 }
 
 // Function to generate a random palette of a given size
-Palette GenerateRandomPalette(const std::string& name, size_t paletteSize) 
+Palette GenerateRandomPalette(const std::string& name, size_t paletteSize, Random& random) 
 {
    Palette palette(name);
    for (size_t i = 0; i < paletteSize; ++i) 
    {
-      palette.AddColor(GenerateRandomColor());
+      palette.AddColor(GenerateRandomColor(random));
    }
    return palette;
 }
 
-PalettesGA::PalettesGA(const BlindnessType type, const size_t size)
+PalettesGA::PalettesGA(const BlindnessType type, const size_t size, const DistanceMetric metric, const uint64_t seed)
+   : PalettesGA(std::vector<BlindnessType>{ type }, size, MultiTypeFitness::WORST_CASE, {}, metric, seed)
+{
+}
+
+PalettesGA::PalettesGA(const std::vector<BlindnessType>& types, const size_t size,
+                       const MultiTypeFitness fitness, const std::vector<double>& weights, const DistanceMetric metric,
+                       const uint64_t seed)
+   : m_Random(seed)
 {
-   m_Type = type;
+   m_Types = types;
+   m_Fitness = fitness;
+   m_Weights = weights;
+   m_Weights.resize(m_Types.size(), 1.0);
+   m_Metric = metric;
+   m_Pool = &ThreadPool::Shared();
+   m_ChunkSize = 1;
+   m_Seed = seed;
+   m_NextStream = 1;
+   for (BlindnessType type : m_Types)
+   {
+      m_ConvertColors.push_back(Converter::GetConvertColorsFunction(type));
+   }
    m_PopulationSize = size;
    m_Palettes.reserve(m_PopulationSize);
 
    for (size_t i = 0; i < m_PopulationSize; i++)
    {
-      auto palette1 = GenerateRandomPalette("", VULCAN_PALETTE_SIZE);
-      Palette palette2("");
-      for (const auto& color : palette1.m_Colors)
+      m_Palettes.emplace_back(GenerateRandomPalette("", VULCAN_PALETTE_SIZE, m_Random));
+   }
+   ConvertPopulation();
+
+   // Every buffer a generation needs is sized here, the loop reuses them
+   m_NextPalettes = m_Palettes;
+   m_Ranking.resize(m_PopulationSize);
+   m_Parents.resize(std::max<size_t>(m_PopulationSize / 2, 1));
+   SetSelection(SelectionMethod::TRUNCATION);
+   m_Crossover = CrossoverMethod::ONE_POINT;
+   m_Mutation = MutationMethod::UNIFORM_SHIFT;
+   m_Evaluated = false;
+}
+
+void PalettesGA::SetParallelism(const size_t threadCount, const size_t chunkSize)
+{
+   m_OwnedPool = std::make_unique<ThreadPool>(threadCount);
+   m_Pool = m_OwnedPool.get();
+   m_ChunkSize = std::max<size_t>(chunkSize, 1);
+}
+
+void PalettesGA::SetMutation(const MutationMethod method)
+{
+   m_Mutation = method;
+}
+
+void PalettesGA::SetCrossover(const CrossoverMethod method)
+{
+   m_Crossover = method;
+}
+
+void PalettesGA::SetSelection(const SelectionMethod method, const size_t tournamentSize)
+{
+   m_Selection = method;
+   m_TournamentSize = std::max<size_t>(tournamentSize, 1);
+
+   // Rank r of n has weight n - r
+   m_RankWeights.resize(m_PopulationSize);
+   double total = 0;
+   for (size_t rank = 0; rank < m_PopulationSize; rank++)
+   {
+      total += double(m_PopulationSize - rank);
+      m_RankWeights[rank] = total;
+   }
+}
+
+template <typename Function>
+void PalettesGA::ForEachIndividual(Function function)
+{
+   size_t chunks = (m_Palettes.size() + m_ChunkSize - 1) / m_ChunkSize;
+   auto chunk = [&](size_t index)
+   {
+      size_t end = std::min(m_Palettes.size(), (index + 1) * m_ChunkSize);
+      for (size_t i = index * m_ChunkSize; i < end; i++)
       {
-         palette2.AddColor(Converter::ConvertColor(color, m_Type));
+         function(m_Palettes[i], i);
       }
-      m_Palettes.push_back(std::make_pair(palette1, palette2));
-   }
+   };
+   m_Pool->ParallelFor(chunks, chunk);
 }
 
 struct HSV {
@@ -638,143 +1266,672 @@ void PalettesGA::RunGA(const size_t numGenerations, const double mutationRate, c
    for (size_t gen = 0; gen < numGenerations; gen++)
    {
       std::cout << "Generation: " << gen << std::endl;
-
-      // Evaluate fitness of each palette
-      EvaluatePopulation();
-
-      // Selection
-      double averageDistance;
-      std::vector<Palette> selectedPalettes = SelectParents(averageDistance);
-
+      double averageDistance = RunGeneration(mutationRate, crossoverRate);
       std::cout << "Average Distance : " << averageDistance << std::endl;
+   }
+   DrawBest();
+}
 
-      // Crossover
-      std::vector<Palette> newGeneration;
-      while (newGeneration.size() < m_PopulationSize) 
+double PalettesGA::RunGeneration(const double mutationRate, const double crossoverRate)
+{
+   // Evaluate fitness of each palette
+   EvaluatePopulation();
+
+   // Selection
+   double averageDistance;
+   SelectParents(averageDistance);
+
+   // The children replace the population, the old one stays readable as
+   // the parents until the next swap
+   std::swap(m_Palettes, m_NextPalettes);
+   const std::vector<Individual>& parents = m_NextPalettes;
+
+   // Every child is either a crossover of two parents or a copy of one,
+   // then mutated and converted, each on its own random stream
+   uint64_t firstStream = m_NextStream;
+   m_NextStream += m_Palettes.size();
+   ForEachIndividual([&](Individual& individual, size_t index)
+   {
+      Random random(m_Seed, firstStream + index);
+      const Individual& parent1 = parents[m_Parents[random.Uniform(uint32_t(m_Parents.size()))]];
+      const Individual& parent2 = parents[m_Parents[random.Uniform(uint32_t(m_Parents.size()))]];
+      // Children inherit their parents' converted colors wherever they
+      // copy colors from them, so only the rest is converted again
+      static thread_local std::vector<uint64_t> dirty;
+      static thread_local std::vector<size_t> changed;
+      bool inherited = true;
+      if (random.Chance(crossoverRate))
       {
-         size_t idx1 = rand() % selectedPalettes.size();
-         size_t idx2 = rand() % selectedPalettes.size();
-         if (static_cast<double>(rand()) / RAND_MAX < crossoverRate) 
+         inherited = Crossover(parent1, parent2, individual, random);
+      }
+      else
+      {
+         individual.m_Palette.m_Colors = parent1.m_Palette.m_Colors;
+         individual.m_Converted = parent1.m_Converted;
+      }
+      dirty.assign((individual.m_Palette.m_Colors.size() + 63) / 64, 0);
+      if (random.Chance(mutationRate)) 
+      {
+         Mutate(individual.m_Palette, mutationRate, random, changed);
+         for (size_t index : changed)
          {
-            Palette child = Crossover(selectedPalettes[idx1], selectedPalettes[idx2]);
-            newGeneration.push_back(child);
+            dirty[index / 64] |= uint64_t(1) << (index % 64);
          }
       }
+      if (inherited)
+      {
+         ConvertDirty(individual, dirty);
+      }
+      else
+      {
+         ConvertPalette(individual);
+      }
+
+      // Children close to parent1 are scored from its pair distances, only
+      // the colors they do not share cost a pass over the palette
+      if (m_Metric == DistanceMetric::RGB)
+      {
+         EvaluateChild(individual, parent1);
+      }
+   });
+   m_Evaluated = m_Metric == DistanceMetric::RGB;
+   return averageDistance;
+}
+
+void PalettesGA::DrawBest()
+{
+   // Scores the last generation, unless that has been done already
+   EvaluatePopulation();
+
+   // One type shows how its readers see the result, several show the source
+   const Individual& fittest = m_Palettes[Fittest()];
+   Palette best = fittest.m_Palette;
+   if (m_Types.size() == 1)
+   {
+      best.m_Colors = fittest.m_Converted;
+   }
+   SortPaletteROYGBIV(best.m_Colors);
+   best.Draw();
+}
+
+size_t PalettesGA::Fittest() const
+{
+   size_t best = 0;
+   for (size_t i = 1; i < m_Palettes.size(); i++)
+   {
+      if (m_Palettes[i].m_Fitness > m_Palettes[best].m_Fitness)
+      {
+         best = i;
+      }
+   }
+   return best;
+}
+
+void PalettesGA::Emigrate(std::vector<Individual>& emigrants)
+{
+   EvaluatePopulation();
+   for (size_t i = 0; i < m_Palettes.size(); i++)
+   {
+      m_Ranking[i] = { m_Palettes[i].m_Fitness, i };
+   }
+   size_t count = std::min(emigrants.size(), m_Ranking.size());
+   std::partial_sort(m_Ranking.begin(), m_Ranking.begin() + count, m_Ranking.end(), std::greater<Ranked>());
+   for (size_t i = 0; i < count; i++)
+   {
+      emigrants[i] = m_Palettes[m_Ranking[i].m_Index];
+   }
+}
+
+void PalettesGA::Immigrate(const std::vector<const Individual*>& immigrants)
+{
+   // Immigrants arrive scored, so only the locals need to be
+   EvaluatePopulation();
+   for (size_t i = 0; i < m_Palettes.size(); i++)
+   {
+      m_Ranking[i] = { m_Palettes[i].m_Fitness, i };
+   }
+
+   // They take the places of the least fit, never more than half of them
+   size_t count = std::min(immigrants.size(), m_Ranking.size() / 2);
+   std::nth_element(m_Ranking.begin(), m_Ranking.end() - count, m_Ranking.end(), std::greater<Ranked>());
+   for (size_t i = 0; i < count; i++)
+   {
+      m_Palettes[m_Ranking[m_Ranking.size() - count + i].m_Index] = *immigrants[i];
+   }
+}
+
+void PalettesGA::ConvertPalette(Individual& individual) const
+{
+   size_t paletteSize = individual.m_Palette.m_Colors.size();
+   individual.m_Converted.resize(m_Types.size() * paletteSize);
+   for (size_t type = 0; type < m_Types.size(); type++)
+   {
+      m_ConvertColors[type](individual.m_Palette.m_Colors.data(), paletteSize,
+                            individual.m_Converted.data() + type * paletteSize);
+   }
+}
 
-      // Mutation
-      for (auto& palette : newGeneration) 
+void PalettesGA::ConvertDirty(Individual& individual, const std::vector<uint64_t>& dirty) const
+{
+   // Gather the dirty colors so every type converts them in one batch
+   static thread_local std::vector<size_t> indices;
+   static thread_local std::vector<Color> colors;
+   static thread_local std::vector<Color> converted;
+   size_t paletteSize = individual.m_Palette.m_Colors.size();
+   indices.clear();
+   colors.clear();
+   for (size_t word = 0; word < dirty.size(); word++)
+   {
+      // Clean runs of 64 colors are skipped whole
+      for (size_t bit = 0; bit < 64 && dirty[word] >> bit != 0; bit++)
       {
-         if (static_cast<double>(rand()) / RAND_MAX < mutationRate) 
+         if ((dirty[word] >> bit) & 1)
          {
-            Mutate(palette, mutationRate);
+            indices.push_back(word * 64 + bit);
+            colors.push_back(individual.m_Palette.m_Colors[word * 64 + bit]);
          }
       }
+   }
+   if (indices.empty())
+   {
+      return;
+   }
 
-      // Update the population with the new generation
-      m_Palettes.clear();
-      for (const auto palette1 : newGeneration)
+   converted.resize(colors.size());
+   for (size_t type = 0; type < m_Types.size(); type++)
+   {
+      m_ConvertColors[type](colors.data(), colors.size(), converted.data());
+      Color* run = individual.m_Converted.data() + type * paletteSize;
+      for (size_t i = 0; i < indices.size(); i++)
       {
-         Palette palette2("");
-         for (const auto& color : palette1.m_Colors)
+         run[indices[i]] = converted[i];
+      }
+   }
+}
+
+void PalettesGA::ConvertPopulation()
+{
+   ForEachIndividual([this](Individual& individual, size_t) { ConvertPalette(individual); });
+}
+
+void PalettesGA::BuildViews(Individual& individual) const
+{
+   size_t paletteSize = individual.m_Palette.m_Colors.size();
+   individual.m_Views.resize(m_Types.size(), Palette(""));
+   for (size_t type = 0; type < m_Types.size(); type++)
+   {
+      Palette& view = individual.m_Views[type];
+      const Color* converted = individual.m_Converted.data() + type * paletteSize;
+      view.m_Colors.assign(converted, converted + paletteSize);
+      view.m_Metric = m_Metric;
+      view.EnableIncrementalEvaluation();
+   }
+   individual.m_ViewsValid = true;
+}
+
+void PalettesGA::EvaluateChild(Individual& child, const Individual& parent) const
+{
+   // Differences of every type, type t's starting at offsets[t]
+   static thread_local std::vector<size_t> indices;
+   static thread_local std::vector<Color> colors;
+   static thread_local std::vector<size_t> offsets;
+   size_t paletteSize = child.m_Palette.m_Colors.size();
+   child.m_ViewsValid = false;
+   if (parent.m_Palette.m_Colors.size() != paletteSize)
+   {
+      EvaluateIndividual(child);
+      return;
+   }
+
+   indices.clear();
+   colors.clear();
+   offsets.assign(1, 0);
+   for (size_t type = 0; type < m_Types.size(); type++)
+   {
+      const Color* converted = child.m_Converted.data() + type * paletteSize;
+      const Color* inherited = parent.m_Converted.data() + type * paletteSize;
+      for (size_t i = 0; i < paletteSize; i++)
+      {
+         if (converted[i] != inherited[i])
          {
-            palette2.AddColor(Converter::ConvertColor(color, m_Type));
+            indices.push_back(i);
+            colors.push_back(converted[i]);
          }
-         m_Palettes.push_back(std::make_pair(palette1, palette2));
       }
+      // Past this a full evaluation is cheaper than the updates
+      if ((indices.size() - offsets.back()) * 4 > paletteSize)
+      {
+         EvaluateIndividual(child);
+         return;
+      }
+      offsets.push_back(indices.size());
    }
 
-   double averaageDistance;
-   std::vector<Palette> selectedPalettes = SelectParents(averaageDistance);
-   // Update the population with the new generation
-   m_Palettes.clear();
-   for (const auto palette1 : selectedPalettes)
+   if (indices.empty())
    {
-      Palette palette2("");
-      for (const auto& color : palette1.m_Colors)
+      // Copying into the arena's views reuses their buffers
+      if (parent.m_ViewsValid)
       {
-         palette2.AddColor(Converter::ConvertColor(color, m_Type));
+         child.m_Views = parent.m_Views;
+      }
+      child.m_ViewsValid = parent.m_ViewsValid;
+      child.m_Fitness = parent.m_Fitness;
+      return;
+   }
+
+   if (parent.m_ViewsValid)
+   {
+      child.m_Views = parent.m_Views;
+      for (size_t type = 0; type < m_Types.size(); type++)
+      {
+         child.m_Views[type].SetColors(indices.data() + offsets[type], colors.data() + offsets[type],
+                                       offsets[type + 1] - offsets[type]);
+      }
+      child.m_ViewsValid = true;
+   }
+   else
+   {
+      BuildViews(child);
+   }
+   EvaluateIndividual(child);
+}
+
+void PalettesGA::EvaluateIndividual(Individual& individual) const
+{
+   static thread_local std::vector<Palette::PaletteEvaluation> evaluations;
+   evaluations.resize(m_Types.size());
+   if (individual.m_ViewsValid)
+   {
+      for (size_t type = 0; type < m_Types.size(); type++)
+      {
+         evaluations[type] = individual.m_Views[type].m_Evaluation;
+      }
+   }
+   else
+   {
+      // Already inside a pool task, so the pair loops below run inline
+      Palette::EvaluateSets(individual.m_Converted.data(), m_Types.size(), individual.m_Palette.m_Colors.size(),
+                            m_Metric, evaluations.data(), *m_Pool);
+   }
+
+   if (m_Fitness == MultiTypeFitness::WEIGHTED)
+   {
+      double weighted = 0, totalWeight = 0;
+      for (size_t type = 0; type < m_Types.size(); type++)
+      {
+         weighted += m_Weights[type] * evaluations[type].m_TotalEvaluation;
+         totalWeight += m_Weights[type];
+      }
+      individual.m_Fitness = totalWeight > 0 ? weighted / totalWeight : 0;
+   }
+   else
+   {
+      individual.m_Fitness = evaluations.empty() ? 0 : evaluations[0].m_TotalEvaluation;
+      for (const auto& evaluation : evaluations)
+      {
+         individual.m_Fitness = std::min(individual.m_Fitness, evaluation.m_TotalEvaluation);
       }
-      m_Palettes.push_back(std::make_pair(palette1, palette2));
    }
-   auto best = m_Palettes.front().second;
-   SortPaletteROYGBIV(best.m_Colors);
-   best.Draw();
 }
 
 void PalettesGA::EvaluatePopulation()
 {
-   for (auto& palettes : m_Palettes)
+   if (m_Evaluated)
    {
-      palettes.second.Evaluate();
+      return;
    }
+   m_Evaluated = true;
+   ForEachIndividual([this](Individual& individual, size_t) { EvaluateIndividual(individual); });
 }
 
-std::vector<Palette> PalettesGA::SelectParents(double& averageDistance)
+void PalettesGA::SelectParents(double& averageDistance)
 {
-   // Sort the palettes based on average color distance
-   std::sort(m_Palettes.begin(), m_Palettes.end(), [](const std::pair<Palette, Palette>& a, const std::pair<Palette, Palette>& b) {
-      return a.second.m_Evaluation.m_TotalEvaluation > b.second.m_Evaluation.m_TotalEvaluation; });
+   for (size_t i = 0; i < m_Palettes.size(); i++)
+   {
+      m_Ranking[i] = { m_Palettes[i].m_Fitness, i };
+   }
+   averageDistance = m_Palettes[Fittest()].m_Fitness;
+
+   switch (m_Selection)
+   {
+   case SelectionMethod::TOURNAMENT:
+      SelectTournament();
+      break;
+   case SelectionMethod::RANK:
+      SelectRank();
+      break;
+   default:
+      SelectTruncation();
+      break;
+   }
+}
+
+void PalettesGA::SelectTruncation()
+{
+   // Only the split between the fitter half and the rest matters, not the
+   // order on either side of it
+   size_t count = m_Parents.size();
+   std::nth_element(m_Ranking.begin(), m_Ranking.begin() + (count - 1), m_Ranking.end(), std::greater<Ranked>());
+   for (size_t i = 0; i < count; i++)
+   {
+      m_Parents[i] = m_Ranking[i].m_Index;
+   }
+}
+
+void PalettesGA::SelectTournament()
+{
+   for (size_t& parent : m_Parents)
+   {
+      const Ranked* winner = &m_Ranking[m_Random.Uniform(uint32_t(m_Ranking.size()))];
+      for (size_t round = 1; round < m_TournamentSize; round++)
+      {
+         const Ranked& challenger = m_Ranking[m_Random.Uniform(uint32_t(m_Ranking.size()))];
+         if (challenger > *winner)
+         {
+            winner = &challenger;
+         }
+      }
+      parent = winner->m_Index;
+   }
+}
+
+void PalettesGA::SelectRank()
+{
+   // The ranking is a few bytes per individual, so sorting it is cheap
+   std::sort(m_Ranking.begin(), m_Ranking.end(), std::greater<Ranked>());
+   double total = m_RankWeights.back();
+   for (size_t& parent : m_Parents)
+   {
+      size_t rank = std::upper_bound(m_RankWeights.begin(), m_RankWeights.end(), m_Random.Real() * total) -
+         m_RankWeights.begin();
+      parent = m_Ranking[std::min(rank, m_Ranking.size() - 1)].m_Index;
+   }
+}
+
+bool PalettesGA::Crossover(const Individual& parent1, const Individual& parent2, Individual& child,
+                           Random& random) const
+{
+   // Assuming parent1 and parent2 have the same number of colors. The
+   // child keeps its buffers, so none of these allocate.
+   size_t paletteSize = parent1.m_Palette.m_Colors.size();
+   child.m_Palette.m_Colors.resize(paletteSize);
+   child.m_Converted.resize(parent1.m_Converted.size());
+
+   // Operators that only move colors around apply the same moves to every
+   // type's converted run, so the child needs no conversion for them
+   auto forEachRun = [&](auto function)
+   {
+      function(parent1.m_Palette.m_Colors.data(), parent2.m_Palette.m_Colors.data(), child.m_Palette.m_Colors.data());
+      for (size_t offset = 0; offset < child.m_Converted.size(); offset += paletteSize)
+      {
+         function(parent1.m_Converted.data() + offset, parent2.m_Converted.data() + offset,
+                  child.m_Converted.data() + offset);
+      }
+   };
+
+   switch (m_Crossover)
+   {
+   case CrossoverMethod::TWO_POINT:
+   {
+      // The second parent's colors between two points, the first's outside
+      size_t first = random.Uniform(uint32_t(paletteSize + 1));
+      size_t second = random.Uniform(uint32_t(paletteSize + 1));
+      if (first > second)
+      {
+         std::swap(first, second);
+      }
+      forEachRun([&](const Color* colors1, const Color* colors2, Color* colors)
+      {
+         std::memcpy(colors, colors1, first * sizeof(Color));
+         std::memcpy(colors + first, colors2 + first, (second - first) * sizeof(Color));
+         std::memcpy(colors + second, colors1 + second, (paletteSize - second) * sizeof(Color));
+      });
+      return true;
+   }
+   case CrossoverMethod::UNIFORM:
+   {
+      // One random bit per color picks its parent
+      static thread_local std::vector<uint64_t> bits;
+      bits.resize((paletteSize + 63) / 64);
+      random.Fill(bits.data(), bits.size());
+      forEachRun([&](const Color* colors1, const Color* colors2, Color* colors)
+      {
+         kernels::SelectColors(reinterpret_cast<const unsigned char*>(colors1),
+                               reinterpret_cast<const unsigned char*>(colors2), bits.data(),
+                               reinterpret_cast<unsigned char*>(colors), paletteSize);
+      });
+      return true;
+   }
+   case CrossoverMethod::BLEND:
+   {
+      // Every channel at the same random point between the two parents, in
+      // 8-bit fixed point. These are new colors, so they need converting.
+      unsigned weight = random.Uniform(257);
+      kernels::BlendBytes(reinterpret_cast<const unsigned char*>(parent1.m_Palette.m_Colors.data()),
+                          reinterpret_cast<const unsigned char*>(parent2.m_Palette.m_Colors.data()), weight,
+                          reinterpret_cast<unsigned char*>(child.m_Palette.m_Colors.data()), paletteSize * sizeof(Color));
+      return false;
+   }
+   default:
+   {
+      // Colors from the first parent up to a random point, then the second's
+      size_t crossoverPoint = random.Uniform(uint32_t(paletteSize));
+      forEachRun([&](const Color* colors1, const Color* colors2, Color* colors)
+      {
+         std::memcpy(colors, colors1, crossoverPoint * sizeof(Color));
+         std::memcpy(colors + crossoverPoint, colors2 + crossoverPoint, (paletteSize - crossoverPoint) * sizeof(Color));
+      });
+      return true;
+   }
+   }
+}
 
-   averageDistance = m_Palettes.front().second.m_Evaluation.m_TotalEvaluation;
+void PalettesGA::Mutate(Palette& palette, const double mutationRate, Random& random,
+                        std::vector<size_t>& changed) const
+{
+   // All the randomness is drawn up front: one word per color holds a 16-bit
+   // roll and three 16-bit shifts, GAUSSIAN_SHIFT and CHANNEL_SHIFT need a
+   // second word for their extra bits
+   static thread_local std::vector<uint64_t> noise;
+   static thread_local std::vector<uint32_t> deltas;
+   static thread_local std::vector<Color> previous;
+   size_t paletteSize = palette.m_Colors.size();
+   size_t words = m_Mutation == MutationMethod::UNIFORM_SHIFT ? 1 : 2;
+   noise.resize(paletteSize * words);
+   random.Fill(noise.data(), noise.size());
+   deltas.resize(paletteSize);
+   uint64_t threshold = uint64_t(std::clamp(mutationRate, 0.0, 1.0) * 65536.0);
+
+   // Shifts are packed into one word per color, laid out like Color with a
+   // 0 pad. Uniform ones are in [-25, 25], Gaussian ones approximate a
+   // standard deviation of 15 with the sum of four random bytes.
+   auto uniformShift = [](uint64_t bits) { return uint32_t(uint8_t(int(((bits & 0xFFFF) * 51) >> 16) - 25)); };
+   auto gaussianShift = [](uint64_t bits)
+   {
+      int sum = int(bits & 0xFF) + int((bits >> 8) & 0xFF) + int((bits >> 16) & 0xFF) + int((bits >> 24) & 0xFF);
+      return uint32_t(uint8_t(((sum - 510) * 13) / 128));
+   };
+   auto pack = [](uint32_t r, uint32_t g, uint32_t b) { return r | g << 8 | b << 16; };
+   // Branch free, a color or channel that is not picked gets its shift
+   // masked to 0
+   auto picked = [threshold](uint64_t roll) { return 0u - uint32_t((roll & 0xFFFF) < threshold); };
+
+   switch (m_Mutation)
+   {
+   case MutationMethod::GAUSSIAN_SHIFT:
+      // Roll in the top of the second word, 32 bits per channel below it
+      for (size_t i = 0; i < paletteSize; i++)
+      {
+         uint64_t bits = noise[2 * i], more = noise[2 * i + 1];
+         deltas[i] = pack(gaussianShift(bits), gaussianShift(bits >> 32), gaussianShift(more)) & picked(more >> 48);
+      }
+      break;
+   case MutationMethod::CHANNEL_SHIFT:
+      // A roll for every channel in the second word
+      for (size_t i = 0; i < paletteSize; i++)
+      {
+         uint64_t bits = noise[2 * i], rolls = noise[2 * i + 1];
+         uint32_t mask = pack(picked(rolls) & 0xFF, picked(rolls >> 16) & 0xFF, picked(rolls >> 32) & 0xFF);
+         deltas[i] = pack(uniformShift(bits), uniformShift(bits >> 16), uniformShift(bits >> 32)) & mask;
+      }
+      break;
+   default:
+      for (size_t i = 0; i < paletteSize; i++)
+      {
+         uint64_t bits = noise[i];
+         deltas[i] = pack(uniformShift(bits), uniformShift(bits >> 16), uniformShift(bits >> 32)) & picked(bits >> 48);
+      }
+      break;
+   }
 
-   // Select the top palettes as parents
-   // For simplicity, let's take the top half
-   size_t numberOfParents = m_PopulationSize / 2;
-   std::vector<Palette> selectedParents;
+   previous = palette.m_Colors;
+   kernels::AddSaturated(reinterpret_cast<unsigned char*>(palette.m_Colors.data()),
+                         reinterpret_cast<const signed char*>(deltas.data()), paletteSize * sizeof(Color));
 
-   for (size_t i = 0; i < numberOfParents; i++) 
+   // Zero shifts and shifts lost to saturation leave a color as it was
+   changed.resize(paletteSize);
+   size_t count = 0;
+   for (size_t i = 0; i < paletteSize; i++)
    {
-      selectedParents.push_back(m_Palettes[i].first);
+      uint32_t before, after;
+      std::memcpy(&before, &previous[i], sizeof(Color));
+      std::memcpy(&after, &palette.m_Colors[i], sizeof(Color));
+      changed[count] = i;
+      count += before != after;
    }
+   changed.resize(count);
+}
+
 
-   return selectedParents;
+PalettesIslands::PalettesIslands(const BlindnessType type, const size_t islands, const size_t size,
+                                 const DistanceMetric metric, const uint64_t seed)
+   : PalettesIslands(std::vector<BlindnessType>{ type }, islands, size, MultiTypeFitness::WORST_CASE, {}, metric, seed)
+{
 }
 
-Palette PalettesGA::Crossover(const Palette& parent1, const Palette& parent2) 
+PalettesIslands::PalettesIslands(const std::vector<BlindnessType>& types, const size_t islands, const size_t size,
+                                 const MultiTypeFitness fitness, const std::vector<double>& weights,
+                                 const DistanceMetric metric, const uint64_t seed)
+   : m_Mailboxes(std::max<size_t>(islands, 1))
 {
-   // Assuming parent1 and parent2 have the same number of colors
-   size_t paletteSize = parent1.m_Colors.size();
+   // Every island seeds from its own stream of the run's seed
+   m_Islands.reserve(m_Mailboxes.size());
+   for (size_t island = 0; island < m_Mailboxes.size(); island++)
+   {
+      m_Islands.emplace_back(types, size, fitness, weights, metric, Random(seed, island).Next());
+   }
+   m_Pool = &ThreadPool::Shared();
+   SetMigration(MigrationTopology::RING, 10, 2);
+}
 
-   // Choose a random crossover point
-   size_t crossoverPoint = rand() % paletteSize;
+void PalettesIslands::SetMigration(const MigrationTopology topology, const size_t interval, const size_t migrants)
+{
+   m_Topology = topology;
+   m_Interval = std::max<size_t>(interval, 1);
+   // Emigrate copies no more than the population, the rest of a larger
+   // slot would be left unscored
+   m_Migrants = std::min(migrants, m_Islands.front().m_Palettes.size());
+   for (size_t island = 0; island < m_Islands.size(); island++)
+   {
+      for (size_t slot = 0; slot < 2; slot++)
+      {
+         m_Mailboxes[island].m_Migrants[slot].assign(m_Migrants, m_Islands[island].m_Palettes.front());
+      }
+   }
+}
 
-   // Create a new palette with the name "Crossover"
-   Palette child("");
+void PalettesIslands::SetParallelism(const size_t threadCount)
+{
+   m_OwnedPool = std::make_unique<ThreadPool>(threadCount);
+   m_Pool = m_OwnedPool.get();
+}
 
-   // Add colors from the first parent up to the crossover point
-   for (size_t i = 0; i < crossoverPoint; i++) 
+void PalettesIslands::RunGA(const size_t numGenerations, const double mutationRate, const double crossoverRate)
+{
+   size_t gen = 0;
+   for (size_t epoch = 0; gen < numGenerations; epoch++)
    {
-      child.AddColor(parent1.m_Colors[i]);
+      size_t generations = std::min(m_Interval, numGenerations - gen);
+      RunEpoch(epoch, generations, mutationRate, crossoverRate);
+      gen += generations;
+
+      // Sending scored every island
+      std::cout << "Generation: " << gen << std::endl;
+      for (size_t index = 0; index < m_Islands.size(); index++)
+      {
+         const PalettesGA& island = m_Islands[index];
+         std::cout << "Island " << index << " Distance : " << island.m_Palettes[island.Fittest()].m_Fitness << std::endl;
+      }
    }
 
-   // Add colors from the second parent from the crossover point to the end
-   for (size_t i = crossoverPoint; i < paletteSize; i++) 
+   // Draw the fittest individual of all the islands, the first island on
+   // ties. Only reads fitness, so another RunGA picks up where this left off.
+   size_t best = 0;
+   double bestFitness = 0;
+   for (size_t index = 0; index < m_Islands.size(); index++)
    {
-      child.AddColor(parent2.m_Colors[i]);
+      PalettesGA& island = m_Islands[index];
+      island.EvaluatePopulation();
+      double fitness = island.m_Palettes[island.Fittest()].m_Fitness;
+      if (index == 0 || fitness > bestFitness)
+      {
+         best = index;
+         bestFitness = fitness;
+      }
    }
+   m_Islands[best].DrawBest();
+}
 
-   return child;
+void PalettesIslands::RunEpoch(size_t epoch, size_t generations, const double mutationRate, const double crossoverRate)
+{
+   // Each island is one pool task, its own per-individual work running
+   // inline inside it
+   auto island = [&](size_t index)
+   {
+      if (epoch > 0)
+      {
+         Receive(index, epoch - 1);
+      }
+      for (size_t i = 0; i < generations; i++)
+      {
+         m_Islands[index].RunGeneration(mutationRate, crossoverRate);
+      }
+      Send(index, epoch);
+   };
+   m_Pool->ParallelFor(m_Islands.size(), island);
 }
 
-void PalettesGA::Mutate(Palette& palette, const double mutationRate) 
+void PalettesIslands::Send(size_t island, size_t epoch)
 {
-   // Iterate through each color in the palette
-   for (Color& color : palette.m_Colors) 
+   m_Islands[island].Emigrate(m_Mailboxes[island].m_Migrants[epoch % 2]);
+}
+
+void PalettesIslands::Receive(size_t island, size_t epoch)
+{
+   static thread_local std::vector<const std::vector<PalettesGA::Individual>*> sources;
+   static thread_local std::vector<const PalettesGA::Individual*> immigrants;
+   sources.clear();
+   for (size_t source = 0; source < m_Islands.size(); source++)
    {
-      // Check if this color should be mutated
-      if (static_cast<double>(rand()) / RAND_MAX < mutationRate) 
+      bool sends = source != island &&
+         (m_Topology == MigrationTopology::ALL_TO_ALL || (source + 1) % m_Islands.size() == island);
+      if (sends)
       {
-         // Randomly adjust the color
-         color.r = (color.r + (rand() % 51 - 25)) % 256; // Adjust R and keep within range
-         color.g = (color.g + (rand() % 51 - 25)) % 256; // Adjust G and keep within range
-         color.b = (color.b + (rand() % 51 - 25)) % 256; // Adjust B and keep within range
+         sources.push_back(&m_Mailboxes[source].m_Migrants[epoch % 2]);
+      }
+   }
 
-         // Ensure color values stay within the 0-255 range
-         color.r = (color.r < 0) ? 0 : (color.r > 255 ? 255 : color.r);
-         color.g = (color.g < 0) ? 0 : (color.g > 255 ? 255 : color.g);
-         color.b = (color.b < 0) ? 0 : (color.b > 255 ? 255 : color.b);
+   // Migrants come best first, so taking every source's best before any
+   // second best shares Immigrate's cap out among all the sources
+   immigrants.clear();
+   for (size_t rank = 0; rank < m_Migrants; rank++)
+   {
+      for (const std::vector<PalettesGA::Individual>* migrants : sources)
+      {
+         immigrants.push_back(&(*migrants)[rank]);
       }
    }
+   m_Islands[island].Immigrate(immigrants);
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,252 @@
+#include "Perceptual.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace color {
+
+static const double PI = 3.14159265358979323846;
+
+// IEC 61966-2-1 sRGB decode, unlike the simulation's double-gamma curve
+static double DecodeStandard(double standard)
+{
+   double value = standard / 255.0;
+   if (value <= 0.04045) { return value / 12.92; }
+   return pow((value + 0.055) / 1.055, 2.4);
+}
+
+// Linear sRGB to XYZ, rows already divided by the D65 white point
+static constexpr double XYZ_MATRIX[9] =
+{
+   0.4124564 / 0.95047, 0.3575761 / 0.95047, 0.1804375 / 0.95047,
+   0.2126729, 0.7151522, 0.0721750,
+   0.0193339 / 1.08883, 0.1191920 / 1.08883, 0.9503041 / 1.08883
+};
+// Linear sRGB to LMS and cube-rooted LMS to Oklab (Ottosson)
+static constexpr double LMS_MATRIX[9] =
+{
+   0.4122214708, 0.5363325363, 0.0514459929,
+   0.2119034982, 0.6806995451, 0.1073969566,
+   0.0883024619, 0.2817188376, 0.6299787005
+};
+static constexpr double OKLAB_MATRIX[9] =
+{
+   0.2104542553, 0.7936177850, -0.0040720468,
+   1.9779984951, -2.4285922050, 0.4505937099,
+   0.0259040371, 0.7827717662, -0.8086757660
+};
+
+static double LabCurve(double t)
+{
+   const double delta = 6.0 / 29.0;
+   if (t > delta * delta * delta) { return cbrt(t); }
+   return t / (3.0 * delta * delta) + 4.0 / 29.0;
+}
+
+static void AssignWith(const PerceptualTables& tables, const Color* colors, size_t count, DistanceMetric metric,
+                       float* x, float* y, float* z)
+{
+   for (size_t i = 0; i < count; i++)
+   {
+      switch (metric)
+      {
+      case DistanceMetric::CIE76:
+      case DistanceMetric::CIE2000:
+         tables.Lab(colors[i], &x[i], &y[i], &z[i]);
+         break;
+      case DistanceMetric::OKLAB:
+         tables.Oklab(colors[i], &x[i], &y[i], &z[i]);
+         break;
+      default:
+         x[i] = float(colors[i].r);
+         y[i] = float(colors[i].g);
+         z[i] = float(colors[i].b);
+         break;
+      }
+   }
+}
+
+const PerceptualTables& PerceptualTables::Get()
+{
+   static const PerceptualTables tables;
+   return tables;
+}
+PerceptualTables::PerceptualTables()
+{
+   for (size_t channel = 0; channel < 3; channel++)
+   {
+      for (size_t value = 0; value < 256; value++)
+      {
+         double linear = DecodeStandard(double(value));
+         for (size_t row = 0; row < 3; row++)
+         {
+            m_Xyz[channel][value][row] = XYZ_MATRIX[row * 3 + channel] * linear;
+            m_Lms[channel][value][row] = LMS_MATRIX[row * 3 + channel] * linear;
+         }
+      }
+   }
+
+   // The eight corners of the RGB cube, every metric measured over them
+   Color corners[8];
+   for (size_t i = 0; i < 8; i++)
+   {
+      corners[i] = Color(i & 1 ? 255 : 0, i & 2 ? 255 : 0, i & 4 ? 255 : 0);
+   }
+   for (size_t metric = 0; metric <= DistanceMetric::LAST_METRIC; metric++)
+   {
+      float x[8], y[8], z[8];
+      AssignWith(*this, corners, 8, DistanceMetric(metric), x, y, z);
+      m_MaxDistance[metric] = 0;
+      for (size_t i = 0; i < 8; i++)
+      {
+         for (size_t j = i + 1; j < 8; j++)
+         {
+            double distance = metric == DistanceMetric::CIE2000 ?
+               perceptual::DeltaE2000(x[i], y[i], z[i], x[j], y[j], z[j]) :
+               sqrt(double((x[i] - x[j]) * (x[i] - x[j]) + (y[i] - y[j]) * (y[i] - y[j]) + (z[i] - z[j]) * (z[i] - z[j])));
+            m_MaxDistance[metric] = std::max(m_MaxDistance[metric], distance);
+         }
+      }
+   }
+}
+void PerceptualTables::Lab(const Color& color, float* L, float* a, float* b) const
+{
+   double xyz[3];
+   for (size_t row = 0; row < 3; row++)
+   {
+      xyz[row] = LabCurve(m_Xyz[0][color.r][row] + m_Xyz[1][color.g][row] + m_Xyz[2][color.b][row]);
+   }
+   *L = float(116.0 * xyz[1] - 16.0);
+   *a = float(500.0 * (xyz[0] - xyz[1]));
+   *b = float(200.0 * (xyz[1] - xyz[2]));
+}
+void PerceptualTables::Oklab(const Color& color, float* L, float* a, float* b) const
+{
+   double lms[3];
+   for (size_t row = 0; row < 3; row++)
+   {
+      lms[row] = cbrt(m_Lms[0][color.r][row] + m_Lms[1][color.g][row] + m_Lms[2][color.b][row]);
+   }
+   *L = float(OKLAB_MATRIX[0] * lms[0] + OKLAB_MATRIX[1] * lms[1] + OKLAB_MATRIX[2] * lms[2]);
+   *a = float(OKLAB_MATRIX[3] * lms[0] + OKLAB_MATRIX[4] * lms[1] + OKLAB_MATRIX[5] * lms[2]);
+   *b = float(OKLAB_MATRIX[6] * lms[0] + OKLAB_MATRIX[7] * lms[1] + OKLAB_MATRIX[8] * lms[2]);
+}
+
+namespace perceptual {
+
+void Assign(const Color* colors, size_t count, DistanceMetric metric, float* x, float* y, float* z)
+{
+   AssignWith(PerceptualTables::Get(), colors, count, metric, x, y, z);
+}
+
+// Sharma, Wu and Dalal's formulation, with the hue angles kept as vectors.
+// The mean hue on the shorter arc is the direction of the sum of the two
+// unit hue vectors, so T's terms come from that through multiple-angle
+// identities. dH' falls out of the dot and cross products. Only the
+// rotation term needs the mean hue as an angle, one atan2 instead of two
+// per pair plus four cosines and a sine.
+static inline double DeltaE2000Pair(double L1, double a1, double b1, double C1,
+                                    double L2, double a2, double b2, double C2)
+{
+   const double POW25_7 = 6103515625.0;
+   const double DEGREE = PI / 180.0;
+
+   double meanC = 0.5 * (C1 + C2);
+   double meanC7 = meanC * meanC * meanC * meanC * meanC * meanC * meanC;
+   double G = 0.5 * (1.0 - sqrt(meanC7 / (meanC7 + POW25_7)));
+   double a1p = (1.0 + G) * a1;
+   double a2p = (1.0 + G) * a2;
+   double C1p = sqrt(a1p * a1p + b1 * b1);
+   double C2p = sqrt(a2p * a2p + b2 * b2);
+
+   // Unit hue vectors, zero for achromatic colors. The standard's special
+   // cases (hue 0 for a gray, the sum instead of the mean when one side is
+   // gray) come out of that on their own.
+   double inverse1 = C1p > 0.0 ? 1.0 / C1p : 0.0;
+   double inverse2 = C2p > 0.0 ? 1.0 / C2p : 0.0;
+   double x1 = a1p * inverse1, y1 = b1 * inverse1;
+   double x2 = a2p * inverse2, y2 = b2 * inverse2;
+   double dot = x1 * x2 + y1 * y2;
+   double cross = x1 * y2 - y1 * x2;
+
+   // Exactly opposite hues average to the lower angle plus 90 degrees
+   bool lowerFirst = y1 > 0.0 || (y1 == 0.0 && x1 > 0.0);
+   double meanX = x1 + x2, meanY = y1 + y2;
+   double length = sqrt(meanX * meanX + meanY * meanY);
+   bool opposite = length < 1e-12 && C1p * C2p > 0.0;
+   double c1 = opposite ? (lowerFirst ? -y1 : -y2) : (length > 0.0 ? meanX / length : 1.0);
+   double s1 = opposite ? (lowerFirst ? x1 : x2) : (length > 0.0 ? meanY / length : 0.0);
+
+   // 2 sqrt(C1' C2') sin(dh' / 2), signed by the shorter turn from 1 to 2
+   double sign = opposite ? (lowerFirst ? 1.0 : -1.0) : (cross < 0.0 ? -1.0 : 1.0);
+   double dH = sign * sqrt(std::max(0.0, 2.0 * C1p * C2p * (1.0 - dot)));
+   double dL = L2 - L1;
+   double dC = C2p - C1p;
+
+   double meanL = 0.5 * (L1 + L2);
+   double meanCp = 0.5 * (C1p + C2p);
+   double c2 = c1 * c1 - s1 * s1, s2 = 2.0 * s1 * c1;
+   double c3 = c2 * c1 - s2 * s1, s3 = s2 * c1 + c2 * s1;
+   double c4 = c2 * c2 - s2 * s2, s4 = 2.0 * s2 * c2;
+   double T = 1.0 - 0.17 * (c1 * cos(30.0 * DEGREE) + s1 * sin(30.0 * DEGREE))
+                  + 0.24 * c2
+                  + 0.32 * (c3 * cos(6.0 * DEGREE) - s3 * sin(6.0 * DEGREE))
+                  - 0.20 * (c4 * cos(63.0 * DEGREE) + s4 * sin(63.0 * DEGREE));
+
+   double meanH = atan2(s1, c1);
+   meanH = meanH < 0.0 ? meanH + 2.0 * PI : meanH;
+   double hueOffset = (meanH / DEGREE - 275.0) / 25.0;
+   double dTheta = 30.0 * DEGREE * exp(-hueOffset * hueOffset);
+   double meanCp7 = meanCp * meanCp * meanCp * meanCp * meanCp * meanCp * meanCp;
+   double RC = 2.0 * sqrt(meanCp7 / (meanCp7 + POW25_7));
+   double lightness = (meanL - 50.0) * (meanL - 50.0);
+   double SL = 1.0 + 0.015 * lightness / sqrt(20.0 + lightness);
+   double SC = 1.0 + 0.045 * meanCp;
+   double SH = 1.0 + 0.015 * meanCp * T;
+   double RT = -sin(2.0 * dTheta) * RC;
+
+   double termL = dL / SL, termC = dC / SC, termH = dH / SH;
+   return sqrt(termL * termL + termC * termC + termH * termH + RT * termC * termH);
+}
+
+double DeltaE2000(float L1, float a1, float b1, float L2, float a2, float b2)
+{
+   return DeltaE2000Pair(L1, a1, b1, sqrt(double(a1) * a1 + double(b1) * b1),
+                         L2, a2, b2, sqrt(double(a2) * a2 + double(b2) * b2));
+}
+void DeltaE2000(float L, float a, float b, const float* otherL, const float* otherA, const float* otherB,
+                size_t count, double* distances)
+{
+   double C = sqrt(double(a) * a + double(b) * b);
+   for (size_t j = 0; j < count; j++)
+   {
+      double a2 = otherA[j], b2 = otherB[j];
+      distances[j] = DeltaE2000Pair(L, a, b, C, otherL[j], a2, b2, sqrt(a2 * a2 + b2 * b2));
+   }
+}
+void DeltaE2000Pairs(const float* L, const float* a, const float* b,
+                     size_t rowBegin, size_t rowEnd, size_t columnBegin, size_t columnEnd, kernels::PairStats& stats)
+{
+   // Batches of distances summed in pair order, like the RGB kernel
+   const size_t BATCH = 256;
+   double distances[BATCH];
+   for (size_t i = rowBegin; i < rowEnd; i++)
+   {
+      for (size_t begin = std::max(columnBegin, i + 1); begin < columnEnd; begin += BATCH)
+      {
+         size_t count = std::min(BATCH, columnEnd - begin);
+         DeltaE2000(L[i], a[i], b[i], L + begin, a + begin, b + begin, count, distances);
+         for (size_t j = 0; j < count; j++)
+         {
+            double squared = distances[j] * distances[j];
+            stats.m_Sum += distances[j];
+            stats.m_MinSquared = std::min(stats.m_MinSquared, squared);
+            stats.m_MaxSquared = std::max(stats.m_MaxSquared, squared);
+         }
+         stats.m_Pairs += count;
+      }
+   }
+}
+
+}
+}
@@ -0,0 +1,29 @@
+#include "Random.h"
+
+namespace color {
+
+static uint64_t SplitMix64(uint64_t& state)
+{
+   uint64_t value = (state += 0x9E3779B97F4A7C15ull);
+   value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+   value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+   return value ^ (value >> 31);
+}
+
+void Random::Seed(uint64_t seed, uint64_t stream)
+{
+   uint64_t mixer = seed ^ SplitMix64(stream);
+   for (uint64_t& word : m_State)
+   {
+      word = SplitMix64(mixer);
+   }
+}
+void Random::Fill(uint64_t* values, size_t count)
+{
+   for (size_t i = 0; i < count; i++)
+   {
+      values[i] = Next();
+   }
+}
+
+}
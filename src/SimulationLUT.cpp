@@ -0,0 +1,416 @@
+#include "SimulationLUT.h"
+#include "Srgb.h"
+#include "Kernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#ifdef COLOR_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace color {
+
+static const char LUT_FILE_MAGIC[8] = { 'C', 'B', 'P', 'L', 'U', 'T', '0', '1' };
+
+// Saved in native byte order, followed by the table data. The matrices are
+// stored so a file built from different matrices is rejected instead of used.
+struct LUTFileHeader
+{
+   char m_Magic[8];
+   uint64_t m_GridSize;
+   uint64_t m_TypeCount;
+   double m_Matrices[BlindnessType::LAST][9];
+};
+
+static void FillHeader(LUTFileHeader& header, size_t gridSize)
+{
+   memset(&header, 0, sizeof(header));
+   memcpy(header.m_Magic, LUT_FILE_MAGIC, sizeof(LUT_FILE_MAGIC));
+   header.m_GridSize = gridSize;
+   header.m_TypeCount = BlindnessType::LAST;
+   for (size_t i = 0; i < BlindnessType::LAST; i++)
+   {
+      memcpy(header.m_Matrices[i], Converter::SimulationMatrix(static_cast<BlindnessType>(i)), sizeof(double) * 9);
+   }
+}
+
+// File mapping
+static const void* MapFile(const std::string& path, size_t* size, void** handle)
+{
+#ifdef _WIN32
+   HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (file == INVALID_HANDLE_VALUE) { return nullptr; }
+
+   LARGE_INTEGER fileSize;
+   if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+   {
+      CloseHandle(file);
+      return nullptr;
+   }
+
+   // The mapping keeps its own reference to the file
+   HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+   CloseHandle(file);
+   if (mapping == NULL) { return nullptr; }
+
+   void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+   if (view == NULL)
+   {
+      CloseHandle(mapping);
+      return nullptr;
+   }
+
+   *size = static_cast<size_t>(fileSize.QuadPart);
+   *handle = mapping;
+   return view;
+#else
+   int file = open(path.c_str(), O_RDONLY);
+   if (file < 0) { return nullptr; }
+
+   struct stat info;
+   if (fstat(file, &info) != 0 || info.st_size == 0)
+   {
+      close(file);
+      return nullptr;
+   }
+
+   void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+   close(file);
+   if (view == MAP_FAILED) { return nullptr; }
+
+   *size = static_cast<size_t>(info.st_size);
+   *handle = nullptr;
+   return view;
+#endif
+}
+static void UnmapFile(const void* view, size_t size, void* handle)
+{
+#ifdef _WIN32
+   UnmapViewOfFile(view);
+   CloseHandle(handle);
+#else
+   (void)handle;
+   munmap(const_cast<void*>(view), size);
+#endif
+}
+// Rename over an existing target in one step, so readers see the old file or
+// the new one and never a missing or partial one
+static bool MoveOver(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+   return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+   return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+static unsigned long ProcessId()
+{
+#ifdef _WIN32
+   return static_cast<unsigned long>(GetCurrentProcessId());
+#else
+   return static_cast<unsigned long>(getpid());
+#endif
+}
+
+// SimulationLUT
+SimulationLUT::SimulationLUT(size_t gridSize, const std::string& cachePath)
+   : m_GridSize(std::max<size_t>(gridSize, 2)), m_Data(nullptr),
+     m_Mapping(nullptr), m_MappingHandle(nullptr), m_MappingSize(0)
+{
+   BuildAxis();
+
+   if (cachePath.empty())
+   {
+      Build();
+      return;
+   }
+
+   std::string path = CacheFileName(cachePath, m_GridSize);
+   if (Load(path)) { return; }
+
+   Build();
+   Save(path);
+}
+SimulationLUT::~SimulationLUT()
+{
+   Unmap();
+}
+
+Color SimulationLUT::Convert(const Color& color, const BlindnessType& type) const
+{
+   return Interpolate(Table(type), color);
+}
+void SimulationLUT::ConvertColors(const Color* colors, size_t count, const BlindnessType& type, Color* converted) const
+{
+   const float* table = Table(type);
+   for (size_t i = 0; i < count; i++)
+   {
+      converted[i] = Interpolate(table, colors[i]);
+   }
+}
+void SimulationLUT::ConvertPalette(const Palette& palette, const BlindnessType& type, Palette& converted) const
+{
+   converted.m_Colors.resize(palette.m_Colors.size());
+   ConvertColors(palette.m_Colors.data(), palette.m_Colors.size(), type, converted.m_Colors.data());
+}
+
+std::string SimulationLUT::CacheFileName(const std::string& path, size_t gridSize)
+{
+   std::string suffix = "." + std::to_string(gridSize);
+   size_t separator = path.find_last_of("/\\");
+   size_t nameBegin = separator == std::string::npos ? 0 : separator + 1;
+   size_t extension = path.find_last_of('.');
+   // No extension, or only a leading dot as in ".cache"
+   if (extension == std::string::npos || extension <= nameBegin) { return path + suffix; }
+   return path.substr(0, extension) + suffix + path.substr(extension);
+}
+
+Color SimulationLUT::Interpolate(const float* table, const Color& color) const
+{
+   const size_t strideB = NODE_SIZE;
+   const size_t strideG = m_GridSize * strideB;
+   const size_t strideR = m_GridSize * strideG;
+
+   const float* c0 = table + m_AxisIndex[color.r] * strideR
+                                 + m_AxisIndex[color.g] * strideG
+                                 + m_AxisIndex[color.b] * strideB;
+   float fr = m_AxisFraction[color.r];
+   float fg = m_AxisFraction[color.g];
+   float fb = m_AxisFraction[color.b];
+
+   // Pick the tetrahedron of the cell containing the point from the order of
+   // the fractions, then walk its edges from the near corner to the far one
+   const float fraction[3] = { fr, fg, fb };
+   const Tetrahedron& tetrahedron = m_Tetrahedra[(fr >= fg) << 2 | (fg >= fb) << 1 | (fr >= fb)];
+   size_t first = tetrahedron.m_First, second = tetrahedron.m_Second;
+   float w1 = fraction[tetrahedron.m_Order[0]];
+   float w2 = fraction[tetrahedron.m_Order[1]];
+   float w3 = fraction[tetrahedron.m_Order[2]];
+   const float* c1 = c0 + first;
+   const float* c2 = c0 + second;
+   const float* c3 = c0 + strideR + strideG + strideB;
+
+   float out[NODE_SIZE];
+#ifdef COLOR_SIMD_X86
+   // One 16-byte load per corner covers all three channels
+   __m128 v0 = _mm_loadu_ps(c0), v1 = _mm_loadu_ps(c1), v2 = _mm_loadu_ps(c2), v3 = _mm_loadu_ps(c3);
+   __m128 sum = _mm_add_ps(v0, _mm_mul_ps(_mm_set1_ps(w1), _mm_sub_ps(v1, v0)));
+   sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w2), _mm_sub_ps(v2, v1)));
+   sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w3), _mm_sub_ps(v3, v2)));
+   _mm_storeu_ps(out, sum);
+#else
+   for (size_t i = 0; i < 3; i++)
+   {
+      out[i] = c0[i] + w1 * (c1[i] - c0[i]) + w2 * (c2[i] - c1[i]) + w3 * (c3[i] - c2[i]);
+   }
+#endif
+
+   // Interpolation stays inside the 0-255 node values, so rounding is enough
+   return Color(int(out[0] + 0.5f), int(out[1] + 0.5f), int(out[2] + 0.5f));
+}
+bool SimulationLUT::Save(const std::string& path) const
+{
+   LUTFileHeader header;
+   FillHeader(header, m_GridSize);
+   const size_t tableCount = m_GridSize * m_GridSize * m_GridSize * NODE_SIZE * BlindnessType::LAST;
+
+   // Write next to the target and rename it over, the target may be mapped
+   // by another process. The suffix keeps concurrent writers apart.
+   std::string tempPath = path + ".tmp" + std::to_string(ProcessId());
+   {
+      std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      file.write(reinterpret_cast<const char*>(m_Data), sizeof(float) * tableCount);
+      if (!file)
+      {
+         std::cerr << "Failed to write simulation LUT to " << tempPath << std::endl;
+         return false;
+      }
+   }
+
+   if (!MoveOver(tempPath, path))
+   {
+      std::cerr << "Failed to replace simulation LUT file " << path << std::endl;
+      std::remove(tempPath.c_str());
+      return false;
+   }
+   return true;
+}
+bool SimulationLUT::Load(const std::string& path)
+{
+   size_t size = 0;
+   void* handle = nullptr;
+   const void* view = MapFile(path, &size, &handle);
+   if (view == nullptr) { return false; }
+
+   LUTFileHeader expected;
+   FillHeader(expected, m_GridSize);
+   const size_t tableCount = m_GridSize * m_GridSize * m_GridSize * NODE_SIZE * BlindnessType::LAST;
+
+   if (size != sizeof(LUTFileHeader) + sizeof(float) * tableCount ||
+       memcmp(view, &expected, sizeof(LUTFileHeader)) != 0)
+   {
+      std::cout << "Ignoring stale simulation LUT file " << path << std::endl;
+      UnmapFile(view, size, handle);
+      return false;
+   }
+
+   Unmap();
+   m_Tables.clear();
+   m_Tables.shrink_to_fit();
+   m_Mapping = const_cast<void*>(view);
+   m_MappingHandle = handle;
+   m_MappingSize = size;
+   m_Data = reinterpret_cast<const float*>(static_cast<const char*>(view) + sizeof(LUTFileHeader));
+   return true;
+}
+
+size_t SimulationLUT::MaxError(const BlindnessType& type, size_t step) const
+{
+   step = std::max<size_t>(step, 1);
+   auto next = [step](size_t value) { return value == 255 ? 256 : std::min<size_t>(value + step, 255); };
+
+   size_t maxError = 0;
+   for (size_t r = 0; r < 256; r = next(r))
+   {
+      for (size_t g = 0; g < 256; g = next(g))
+      {
+         for (size_t b = 0; b < 256; b = next(b))
+         {
+            Color color(r, g, b);
+            Color exact = Converter::ConvertColorExact(color, type);
+            Color approx = Convert(color, type);
+            maxError = std::max({ maxError,
+               size_t(std::abs(int(exact.r) - int(approx.r))),
+               size_t(std::abs(int(exact.g) - int(approx.g))),
+               size_t(std::abs(int(exact.b) - int(approx.b))) });
+         }
+      }
+   }
+   return maxError;
+}
+void SimulationLUT::PrintAccuracy(size_t step) const
+{
+   std::cout << "Simulation LUT " << m_GridSize << "^3 max error:" << std::endl;
+   for (size_t i = 0; i < BlindnessType::LAST; i++)
+   {
+      BlindnessType type = static_cast<BlindnessType>(i);
+      std::cout << BlindnessTypeNames.at(type) << ": " << MaxError(type, step) << std::endl;
+   }
+}
+
+void SimulationLUT::Build()
+{
+   const size_t n = m_GridSize;
+   const size_t tableSize = n * n * n * NODE_SIZE;
+   m_Tables.resize(tableSize * BlindnessType::LAST);
+
+   // Grid points sit between the 8-bit steps, so use the unquantized curves
+   std::vector<double> standard(n), linear(n);
+   for (size_t i = 0; i < n; i++)
+   {
+      standard[i] = i * 255.0 / (n - 1);
+      linear[i] = SrgbTables::DecodeCurve(standard[i]);
+   }
+   auto encode = [](double value) {
+      return static_cast<float>(std::min(std::max(SrgbTables::EncodeCurve(value), 0.0), 255.0));
+   };
+
+   for (size_t i = 0; i < BlindnessType::LAST; i++)
+   {
+      BlindnessType type = static_cast<BlindnessType>(i);
+      const double* matrix = Converter::SimulationMatrix(type);
+      float* table = &m_Tables[i * tableSize];
+
+      for (size_t r = 0; r < n; r++)
+      {
+         for (size_t g = 0; g < n; g++)
+         {
+            for (size_t b = 0; b < n; b++)
+            {
+               float* node = table + ((r * n + g) * n + b) * NODE_SIZE;
+               if (type == BlindnessType::NORMAL)
+               {
+                  node[0] = float(standard[r]);
+                  node[1] = float(standard[g]);
+                  node[2] = float(standard[b]);
+                  node[3] = 0.0f;
+                  continue;
+               }
+
+               double convertedR, convertedG, convertedB;
+               Converter::ApplyMatrix(matrix, linear[r], linear[g], linear[b], &convertedR, &convertedG, &convertedB);
+               node[0] = encode(convertedR);
+               node[1] = encode(convertedG);
+               node[2] = encode(convertedB);
+               node[3] = 0.0f;
+            }
+         }
+      }
+   }
+
+   Unmap();
+   m_Data = m_Tables.data();
+}
+void SimulationLUT::BuildAxis()
+{
+   const size_t strideB = NODE_SIZE;
+   const size_t strideG = m_GridSize * strideB;
+   const size_t strideR = m_GridSize * strideG;
+
+   // Indexed by (r >= g, g >= b, r >= b); two of the keys cannot happen
+   const Tetrahedron tetrahedra[8] =
+   {
+      { strideB, strideG + strideB, { 2, 1, 0 } }, // b > g > r
+      { strideB, strideG + strideB, { 2, 1, 0 } },
+      { strideG, strideG + strideB, { 1, 2, 0 } }, // g >= b > r
+      { strideG, strideR + strideG, { 1, 0, 2 } }, // g > r >= b
+      { strideB, strideR + strideB, { 2, 0, 1 } }, // b > r >= g
+      { strideR, strideR + strideB, { 0, 2, 1 } }, // r >= b > g
+      { strideR, strideR + strideG, { 0, 1, 2 } },
+      { strideR, strideR + strideG, { 0, 1, 2 } }, // r >= g >= b
+   };
+   std::copy(tetrahedra, tetrahedra + 8, m_Tetrahedra);
+
+   for (size_t i = 0; i < 256; i++)
+   {
+      double position = i * double(m_GridSize - 1) / 255.0;
+      size_t index = std::min(static_cast<size_t>(position), m_GridSize - 2);
+      m_AxisIndex[i] = index;
+      m_AxisFraction[i] = static_cast<float>(position - index);
+   }
+}
+void SimulationLUT::Unmap()
+{
+   if (m_Mapping == nullptr) { return; }
+
+   UnmapFile(m_Mapping, m_MappingSize, m_MappingHandle);
+   m_Mapping = nullptr;
+   m_MappingHandle = nullptr;
+   m_MappingSize = 0;
+   m_Data = nullptr;
+}
+const float* SimulationLUT::Table(const BlindnessType& type) const
+{
+   size_t index = type < BlindnessType::LAST ? static_cast<size_t>(type) : static_cast<size_t>(BlindnessType::NORMAL);
+   return m_Data + index * m_GridSize * m_GridSize * m_GridSize * NODE_SIZE;
+}
+
+}
@@ -0,0 +1,80 @@
+#include "Srgb.h"
+
+#include <cmath>
+#include <limits>
+
+namespace color {
+
+double SrgbTables::DecodeCurve(double standard)
+{
+   // Convert RGB value to the 0-1 range
+   double value = standard / 255.0;
+
+   // Apply gamma correction to the RGB value
+   double gamma = 2.2;
+   value = pow(value, gamma);
+
+   // Convert gamma-corrected RGB value to linear RGB value
+   double a = 0.055;
+   if (value <= 0.04045) { return value / 12.92; }
+   return pow((value + a) / (1.0 + a), 2.4);
+}
+
+double SrgbTables::EncodeCurve(double linear)
+{
+   // Convert linear RGB value to sRGB value
+   double a = 0.055;
+   if (linear <= 0.0031308) { return 255.0 * linear * 12.92; }
+   return 255.0 * ((1.0 + a) * pow(linear, 1.0 / 2.4) - a);
+}
+
+static double EncodeChannel(double linear)
+{
+   return round(SrgbTables::EncodeCurve(linear));
+}
+
+static double FindEncodeThreshold(size_t channel)
+{
+   // Bisect down to the first double that encodes to channel
+   double low = 0.0, high = 1.0;
+   while (true)
+   {
+      double mid = low + (high - low) / 2.0;
+      if (mid <= low || mid >= high) { return high; }
+      if (EncodeChannel(mid) >= channel) { high = mid; }
+      else { low = mid; }
+   }
+}
+
+SrgbTables::SrgbTables()
+{
+   for (size_t i = 0; i < 256; i++)
+   {
+      m_Decode[i] = DecodeCurve(double(i));
+   }
+
+   m_EncodeThresholds[0] = 0.0;
+   for (size_t i = 1; i < 256; i++)
+   {
+      m_EncodeThresholds[i] = FindEncodeThreshold(i);
+   }
+   m_EncodeThresholds[256] = std::numeric_limits<double>::infinity();
+
+   for (size_t i = 0; i < ENCODE_BUCKETS; i++)
+   {
+      m_EncodeBuckets[i] = static_cast<unsigned char>(EncodeChannel(double(i) / ENCODE_BUCKETS));
+   }
+   for (size_t i = ENCODE_BUCKETS; i < ENCODE_BUCKETS + 4; i++)
+   {
+      m_EncodeBuckets[i] = 255;
+   }
+}
+
+const SrgbTables& SrgbTables::Get()
+{
+   // Built on first use, so it is ready even for static initializers
+   static const SrgbTables tables;
+   return tables;
+}
+
+}
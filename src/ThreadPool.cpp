@@ -0,0 +1,103 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace color {
+
+// Set while a thread is running tasks, a nested Run must not wait on itself
+static thread_local bool t_InsideRun = false;
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+   if (threadCount == 0)
+   {
+      threadCount = std::max(1u, std::thread::hardware_concurrency());
+   }
+   m_Workers.reserve(threadCount - 1);
+   for (size_t i = 1; i < threadCount; i++)
+   {
+      m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+   }
+}
+ThreadPool::~ThreadPool()
+{
+   {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Stop = true;
+   }
+   m_WakeCondition.notify_all();
+   for (std::thread& worker : m_Workers)
+   {
+      worker.join();
+   }
+}
+ThreadPool& ThreadPool::Shared()
+{
+   static ThreadPool pool;
+   return pool;
+}
+void ThreadPool::Run(size_t taskCount, TaskFunction task, void* context)
+{
+   std::unique_lock<std::mutex> runLock(m_RunMutex, std::defer_lock);
+   if (m_Workers.empty() || taskCount < 2 || t_InsideRun || !runLock.try_lock())
+   {
+      for (size_t i = 0; i < taskCount; i++)
+      {
+         task(context, i);
+      }
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Task = task;
+      m_Context = context;
+      m_TaskCount = taskCount;
+      m_NextTask = 0;
+      m_ActiveWorkers = m_Workers.size();
+      m_Generation++;
+   }
+   m_WakeCondition.notify_all();
+
+   Work();
+
+   std::unique_lock<std::mutex> lock(m_Mutex);
+   m_DoneCondition.wait(lock, [this] { return m_ActiveWorkers == 0; });
+   m_Task = nullptr;
+   m_Context = nullptr;
+}
+void ThreadPool::WorkerLoop()
+{
+   size_t generation = 0;
+   while (true)
+   {
+      {
+         std::unique_lock<std::mutex> lock(m_Mutex);
+         m_WakeCondition.wait(lock, [&] { return m_Stop || m_Generation != generation; });
+         if (m_Stop)
+         {
+            return;
+         }
+         generation = m_Generation;
+      }
+
+      Work();
+
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      if (--m_ActiveWorkers == 0)
+      {
+         m_DoneCondition.notify_one();
+      }
+   }
+}
+void ThreadPool::Work()
+{
+   t_InsideRun = true;
+   for (size_t i = m_NextTask++; i < m_TaskCount; i = m_NextTask++)
+   {
+      m_Task(m_Context, i);
+   }
+   t_InsideRun = false;
+}
+
+}
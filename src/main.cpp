@@ -1,4 +1,5 @@
 #include <iostream>
+#include <cstring>
 #include "Palette.h"
 
 #include "GLEW/glew.h" 
@@ -6,6 +7,12 @@
 
 int main(int argc, char* argv[])
 {
+   // --lut converts through cached 33^3 simulation tables instead of the matrices
+   if (argc > 1 && strcmp(argv[1], "--lut") == 0)
+   {
+      color::Converter::EnableSimulationLUT(33, "simulation.lut");
+   }
+
    color::PalettesGA palettes(color::BlindnessType::DEUTERANOPIA, 30);
    palettes.RunGA(1000, 0.8, 0.3);
 
@@ -0,0 +1,134 @@
+#include "GAAccess.h"
+#include "Palette.h"
+#include "Srgb.h"
+
+#include <chrono>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+using namespace color;
+
+// Keeps results alive so the timed loops are not optimized away
+static volatile double s_Sink;
+
+template <typename Function>
+static void Measure(const char* name, size_t items, const char* unit, Function function)
+{
+   // One untimed pass to warm tables and caches
+   function();
+   const size_t ROUNDS = 5;
+   auto start = std::chrono::steady_clock::now();
+   for (size_t round = 0; round < ROUNDS; round++)
+   {
+      function();
+   }
+   double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   std::printf("%-40s %10.2f ns/%s\n", name, seconds * 1e9 / (double(ROUNDS) * items), unit);
+}
+
+int main()
+{
+   const size_t COLORS = 1 << 20;
+   Random random(1);
+   std::vector<Color> colors(COLORS), converted(COLORS);
+   for (Color& color : colors)
+   {
+      color = Color(uint8_t(random.Uniform(256)), uint8_t(random.Uniform(256)), uint8_t(random.Uniform(256)));
+   }
+
+   // Decode: the pow() curve the table replaced, then the table
+   Measure("decode, pow curve", COLORS, "color", [&]() {
+      double sum = 0;
+      for (const Color& color : colors)
+      {
+         sum += SrgbTables::DecodeCurve(color.r) + SrgbTables::DecodeCurve(color.g) + SrgbTables::DecodeCurve(color.b);
+      }
+      s_Sink = sum;
+   });
+   Measure("decode, Converter::StandardToLinear", COLORS, "color", [&]() {
+      double sum = 0;
+      for (const Color& color : colors)
+      {
+         double r, g, b;
+         Converter::StandardToLinear(color, &r, &g, &b);
+         sum += r + g + b;
+      }
+      s_Sink = sum;
+   });
+
+   // Encode: round(pow()) against the tables
+   const SrgbTables& tables = SrgbTables::Get();
+   Measure("encode, pow curve", COLORS, "color", [&]() {
+      double sum = 0;
+      for (const Color& color : colors)
+      {
+         sum += round(SrgbTables::EncodeCurve(tables.m_Decode[color.r])) +
+            round(SrgbTables::EncodeCurve(tables.m_Decode[color.g])) +
+            round(SrgbTables::EncodeCurve(tables.m_Decode[color.b]));
+      }
+      s_Sink = sum;
+   });
+   Measure("encode, Converter::LinearToStandard", COLORS, "color", [&]() {
+      double sum = 0;
+      for (const Color& color : colors)
+      {
+         Color standard;
+         Converter::LinearToStandard(tables.m_Decode[color.r], tables.m_Decode[color.g], tables.m_Decode[color.b],
+                                     &standard);
+         sum += standard.r + standard.g + standard.b;
+      }
+      s_Sink = sum;
+   });
+
+   // Whole conversions, one color per call and batched
+   Measure("convert, Converter::ConvertColor", COLORS, "color", [&]() {
+      for (size_t i = 0; i < COLORS; i++)
+      {
+         converted[i] = Converter::ConvertColor(colors[i], BlindnessType::DEUTERANOPIA);
+      }
+      s_Sink = converted[COLORS / 2].r;
+   });
+   Measure("convert, Converter::ConvertColors", COLORS, "color", [&]() {
+      Converter::ConvertColors(colors.data(), COLORS, BlindnessType::DEUTERANOPIA, converted.data());
+      s_Sink = converted[COLORS / 2].r;
+   });
+
+   // Evaluation of a GA-sized palette
+   Palette palette("");
+   palette.m_Colors.assign(colors.begin(), colors.begin() + VULCAN_PALETTE_SIZE);
+   const size_t EVALUATIONS = 2000;
+   Measure("evaluate, 256 colors", EVALUATIONS, "palette", [&]() {
+      for (size_t i = 0; i < EVALUATIONS; i++)
+      {
+         palette.Evaluate();
+      }
+      s_Sink = palette.m_Evaluation.m_TotalEvaluation;
+   });
+
+   // One child per crossover from two GA-sized parents, converted runs included
+   PalettesGA ga(BlindnessType::DEUTERANOPIA, 2);
+   const std::vector<GAAccess::Individual>& parents = GAAccess::Population(ga);
+   GAAccess::Individual child = parents[0];
+   const size_t CHILDREN = 100000;
+   const std::pair<CrossoverMethod, const char*> crossovers[] =
+   {
+      { CrossoverMethod::ONE_POINT, "crossover, ONE_POINT" },
+      { CrossoverMethod::TWO_POINT, "crossover, TWO_POINT" },
+      { CrossoverMethod::UNIFORM, "crossover, UNIFORM" },
+      { CrossoverMethod::BLEND, "crossover, BLEND" },
+   };
+   for (const auto& crossover : crossovers)
+   {
+      ga.SetCrossover(crossover.first);
+      Measure(crossover.second, CHILDREN, "child", [&]() {
+         Random childRandom(2);
+         for (size_t i = 0; i < CHILDREN; i++)
+         {
+            GAAccess::Crossover(ga, parents[0], parents[1], child, childRandom);
+         }
+         s_Sink = child.m_Palette.m_Colors[VULCAN_PALETTE_SIZE / 2].r;
+      });
+   }
+   return 0;
+}
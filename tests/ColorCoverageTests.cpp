@@ -0,0 +1,104 @@
+#include "Test.h"
+#include "ColorCoverage.h"
+#include "Palette.h"
+#include "Random.h"
+
+#include <vector>
+
+using namespace color;
+
+// Bins within one step of any color's bin on every axis, counted one bin at a time
+static size_t BruteForceCoverage(const std::vector<Color>& colors, bool dilate)
+{
+   const int AXIS = int(ColorCoverage::AXIS);
+   std::vector<bool> covered(ColorCoverage::BINS, false);
+   int reach = dilate ? 1 : 0;
+   for (const Color& color : colors)
+   {
+      int r = color.r >> ColorCoverage::AXIS_BITS;
+      int g = color.g >> ColorCoverage::AXIS_BITS;
+      int b = color.b >> ColorCoverage::AXIS_BITS;
+      for (int dr = -reach; dr <= reach; dr++)
+      {
+         for (int dg = -reach; dg <= reach; dg++)
+         {
+            for (int db = -reach; db <= reach; db++)
+            {
+               int x = r + dr, y = g + dg, z = b + db;
+               if (x >= 0 && x < AXIS && y >= 0 && y < AXIS && z >= 0 && z < AXIS)
+               {
+                  covered[(x * AXIS + y) * AXIS + z] = true;
+               }
+            }
+         }
+      }
+   }
+   size_t count = 0;
+   for (bool bin : covered)
+   {
+      count += bin;
+   }
+   return count;
+}
+
+static void CheckCoverage(const std::vector<Color>& colors)
+{
+   ColorCoverage coverage(colors.data(), colors.size());
+   CHECK(coverage.Count() == BruteForceCoverage(colors, false));
+   coverage.Dilate();
+   size_t expected = BruteForceCoverage(colors, true);
+   CHECK(coverage.Count() == expected);
+   CHECK(ColorCoverage::Representation(colors.data(), colors.size()) == double(expected) / ColorCoverage::BINS);
+}
+
+TEST(ColorCoverageMatchesBruteForceOnEdges)
+{
+   // Nothing, the corners, and bins on the edges of the 16-bit rows, the
+   // words and the r slices, where the shifts carry between them
+   CheckCoverage({});
+   CheckCoverage({ Color(0, 0, 0) });
+   CheckCoverage({ Color(255, 255, 255) });
+   CheckCoverage({ Color(0, 255, 0), Color(255, 0, 255) });
+   const uint8_t edges[] = { 0, 15, 16, 63, 64, 65, 127, 128, 240, 255 };
+   for (uint8_t r : edges)
+   {
+      for (uint8_t g : edges)
+      {
+         for (uint8_t b : edges)
+         {
+            CheckCoverage({ Color(r, g, b) });
+         }
+      }
+   }
+}
+
+TEST(ColorCoverageMatchesBruteForceOnRandomPalettes)
+{
+   Random random(51);
+   const size_t sizes[] = { 2, 5, 20, 64, 256, 1000 };
+   for (size_t size : sizes)
+   {
+      for (size_t round = 0; round < 10; round++)
+      {
+         std::vector<Color> colors(size);
+         for (Color& color : colors)
+         {
+            color = Color(uint8_t(random.Uniform(256)), uint8_t(random.Uniform(256)), uint8_t(random.Uniform(256)));
+         }
+         CheckCoverage(colors);
+      }
+   }
+}
+
+TEST(EvaluateReportsCoverage)
+{
+   Random random(52);
+   Palette palette("");
+   for (size_t i = 0; i < 100; i++)
+   {
+      palette.AddColor(Color(uint8_t(random.Uniform(256)), uint8_t(random.Uniform(256)), uint8_t(random.Uniform(256))));
+   }
+   palette.Evaluate();
+   CHECK(palette.m_Evaluation.m_ColorRepresentation ==
+         double(BruteForceCoverage(palette.m_Colors, true)) / ColorCoverage::BINS);
+}
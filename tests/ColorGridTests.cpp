@@ -0,0 +1,133 @@
+#include "Test.h"
+#include "ColorGrid.h"
+#include "Palette.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+using namespace color;
+
+static uint32_t Squared(const Color& first, const Color& second)
+{
+   int dr = int(first.r) - int(second.r), dg = int(first.g) - int(second.g), db = int(first.b) - int(second.b);
+   return uint32_t(dr * dr + dg * dg + db * db);
+}
+
+static Color RandomColor(Random& random)
+{
+   return Color(uint8_t(random.Uniform(256)), uint8_t(random.Uniform(256)), uint8_t(random.Uniform(256)));
+}
+
+enum GridLayout : size_t
+{
+   SPREAD,
+   // A few tight clusters, so most cells are empty and a few are crowded
+   CLUSTERED,
+   // Drawn from a handful of colors, so most distances are 0
+   DUPLICATES
+};
+
+static Palette GridPalette(GridLayout layout, size_t size, Random& random)
+{
+   Palette palette("");
+   std::vector<Color> centers;
+   for (size_t i = 0; i < 5; i++)
+   {
+      centers.push_back(RandomColor(random));
+   }
+   for (size_t i = 0; i < size; i++)
+   {
+      const Color& center = centers[random.Uniform(uint32_t(centers.size()))];
+      auto jitter = [&](uint8_t channel) { return uint8_t(std::clamp(int(channel) + int(random.Uniform(13)) - 6, 0, 255)); };
+      switch (layout)
+      {
+      case GridLayout::CLUSTERED: palette.m_Colors.push_back(Color(jitter(center.r), jitter(center.g), jitter(center.b))); break;
+      case GridLayout::DUPLICATES: palette.m_Colors.push_back(center); break;
+      default: palette.m_Colors.push_back(RandomColor(random)); break;
+      }
+   }
+   return palette;
+}
+
+TEST(ColorGridMatchesBruteForce)
+{
+   const size_t sizes[] = { 0, 1, 2, 3, 17, 256, 1000, 3000 };
+   const GridLayout layouts[] = { GridLayout::SPREAD, GridLayout::CLUSTERED, GridLayout::DUPLICATES };
+   Random random(41);
+   for (GridLayout layout : layouts)
+   {
+      for (size_t size : sizes)
+      {
+         Palette palette = GridPalette(layout, size, random);
+         const std::vector<Color>& colors = palette.m_Colors;
+         ColorGrid grid(palette);
+
+         // Every color's nearest other color, and the closest pair
+         std::vector<uint32_t> expected(size, UINT32_MAX);
+         uint32_t closest = UINT32_MAX;
+         for (size_t i = 0; i < size; i++)
+         {
+            for (size_t j = 0; j < size; j++)
+            {
+               if (i != j)
+               {
+                  expected[i] = std::min(expected[i], Squared(colors[i], colors[j]));
+               }
+            }
+            closest = std::min(closest, expected[i]);
+         }
+
+         std::vector<uint32_t> nearest;
+         grid.NearestSquared(nearest);
+         CHECK(nearest == expected);
+
+         size_t first = ColorGrid::NONE, second = ColorGrid::NONE;
+         CHECK(grid.ClosestPair(&first, &second) == closest);
+         if (size > 1)
+         {
+            CHECK(first != second && first < size && second < size);
+            CHECK(Squared(colors[first % size], colors[second % size]) == closest);
+         }
+
+         // Ties can pick any index, so only its distance is compared
+         for (size_t i = 0; i < size; i += std::max<size_t>(size / 50, 1))
+         {
+            uint32_t squared = 0;
+            size_t index = grid.Nearest(colors[i], &squared, i);
+            if (size == 1)
+            {
+               CHECK(index == ColorGrid::NONE);
+               continue;
+            }
+            CHECK(index != i && index < size && squared == expected[i]);
+            CHECK(Squared(colors[i], colors[index % size]) == squared);
+         }
+         for (size_t query = 0; query < 50 && size > 0; query++)
+         {
+            Color color = RandomColor(random);
+            uint32_t best = UINT32_MAX;
+            for (const Color& other : colors)
+            {
+               best = std::min(best, Squared(color, other));
+            }
+            uint32_t squared = 0;
+            size_t index = grid.Nearest(color, &squared);
+            CHECK(index < size && squared == best);
+         }
+
+         // The Palette wrappers report plain distances
+         std::vector<double> distances;
+         palette.NearestDistances(distances);
+         CHECK(distances.size() == size);
+         for (size_t i = 0; i < distances.size(); i++)
+         {
+            CHECK(distances[i] == (expected[i] == UINT32_MAX ? DBL_MAX : sqrt(double(expected[i]))));
+         }
+         CHECK(palette.MinDistance() == (closest == UINT32_MAX ? DBL_MAX : sqrt(double(closest))));
+      }
+   }
+}
@@ -0,0 +1,193 @@
+#include "Test.h"
+#include "Palette.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace color;
+
+static Palette RandomPalette(size_t size, uint64_t seed)
+{
+   Random random(seed);
+   Palette palette("");
+   for (size_t i = 0; i < size; i++)
+   {
+      palette.AddColor(Color(uint8_t(random.Uniform(256)), uint8_t(random.Uniform(256)), uint8_t(random.Uniform(256))));
+   }
+   return palette;
+}
+
+static bool BitwiseEqual(double a, double b)
+{
+   return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+static bool BitwiseEqual(const Palette::PaletteEvaluation& a, const Palette::PaletteEvaluation& b)
+{
+   return BitwiseEqual(a.m_AverageDistance, b.m_AverageDistance) && BitwiseEqual(a.m_MinDistance, b.m_MinDistance) &&
+      BitwiseEqual(a.m_MaxDistance, b.m_MaxDistance) &&
+      BitwiseEqual(a.m_ColorRepresentation, b.m_ColorRepresentation) &&
+      BitwiseEqual(a.m_TotalEvaluation, b.m_TotalEvaluation);
+}
+
+// Evaluates on pools of 1, 2, 8 and one thread per core, which must all
+// agree bit for bit. The sizes take the tiled path, 3001 with ragged tiles.
+static void CheckThreadCountIndependence(DistanceMetric metric, std::initializer_list<size_t> sizes)
+{
+   const size_t threadCounts[] = { 1, 2, 8, 0 };
+   for (size_t size : sizes)
+   {
+      Palette palette = RandomPalette(size, size);
+      palette.m_Metric = metric;
+      std::unique_ptr<Palette::PaletteEvaluation> first;
+      for (size_t threads : threadCounts)
+      {
+         ThreadPool pool(threads);
+         palette.Evaluate(pool);
+         if (!first)
+         {
+            first = std::make_unique<Palette::PaletteEvaluation>(palette.m_Evaluation);
+            continue;
+         }
+         CHECK(BitwiseEqual(*first, palette.m_Evaluation));
+      }
+   }
+}
+
+TEST(EvaluateIsThreadCountIndependentRgb)
+{
+   CheckThreadCountIndependence(DistanceMetric::RGB, { 2048, 3001, 5000 });
+}
+
+TEST(EvaluateIsThreadCountIndependentPerceptual)
+{
+   CheckThreadCountIndependence(DistanceMetric::OKLAB, { 2048, 3001 });
+   CheckThreadCountIndependence(DistanceMetric::CIE2000, { 600, 1100 });
+}
+
+TEST(EvaluateSmallPaletteMatchesPlainLoop)
+{
+   // Below the tiling cutoff the sum keeps row-major pair order
+   Palette palette = RandomPalette(300, 7);
+   palette.Evaluate();
+   double sum = 0, minDistance = DBL_MAX, maxDistance = 0;
+   for (size_t i = 0; i < palette.m_Colors.size(); i++)
+   {
+      for (size_t j = i + 1; j < palette.m_Colors.size(); j++)
+      {
+         double distance = palette.m_Colors[i].Distance(palette.m_Colors[j]);
+         sum += distance;
+         minDistance = std::min(minDistance, distance);
+         maxDistance = std::max(maxDistance, distance);
+      }
+   }
+   const double maxColorDistance = sqrt(3.0 * 255.0 * 255.0);
+   size_t pairs = palette.m_Colors.size() * (palette.m_Colors.size() - 1) / 2;
+   CHECK(BitwiseEqual(palette.m_Evaluation.m_AverageDistance, sum / pairs / maxColorDistance));
+   CHECK(BitwiseEqual(palette.m_Evaluation.m_MinDistance, minDistance / maxColorDistance));
+   CHECK(BitwiseEqual(palette.m_Evaluation.m_MaxDistance, maxDistance / maxColorDistance));
+}
+
+static bool Close(double a, double b)
+{
+   return fabs(a - b) <= 1e-12 * std::max(1.0, fabs(b));
+}
+
+TEST(IncrementalSetColorMatchesEvaluate)
+{
+   Random random(11);
+   Palette palette = RandomPalette(64, 3);
+   palette.EnableIncrementalEvaluation();
+   for (size_t step = 1; step <= 600; step++)
+   {
+      size_t index = random.Uniform(palette.m_Colors.size());
+      // Every few steps copy another color, which makes and breaks zero
+      // distance minimums and forces rescans
+      Color color = step % 7 == 0 ? palette.m_Colors[random.Uniform(palette.m_Colors.size())]
+         : Color(uint8_t(random.Uniform(256)), uint8_t(random.Uniform(256)), uint8_t(random.Uniform(256)));
+      palette.SetColor(index, color);
+      if (step % 20 != 0)
+      {
+         continue;
+      }
+
+      Palette full("");
+      full.m_Colors = palette.m_Colors;
+      full.Evaluate();
+      const Palette::PaletteEvaluation& incremental = palette.m_Evaluation;
+      const Palette::PaletteEvaluation& expected = full.m_Evaluation;
+      CHECK(BitwiseEqual(incremental.m_MinDistance, expected.m_MinDistance));
+      CHECK(BitwiseEqual(incremental.m_MaxDistance, expected.m_MaxDistance));
+      CHECK(BitwiseEqual(incremental.m_ColorRepresentation, expected.m_ColorRepresentation));
+      CHECK(Close(incremental.m_AverageDistance, expected.m_AverageDistance));
+      CHECK(Close(incremental.m_TotalEvaluation, expected.m_TotalEvaluation));
+   }
+}
+
+TEST(IncrementalSetColorsMatchesEvaluate)
+{
+   // Small batches take the incremental path, large ones the full pass
+   Random random(5);
+   Palette palette = RandomPalette(128, 9);
+   palette.EnableIncrementalEvaluation();
+   const size_t batchSizes[] = { 1, 3, 8, 31, 33, 100 };
+   for (size_t round = 0; round < 60; round++)
+   {
+      size_t count = batchSizes[round % 6];
+      std::vector<size_t> indices(count);
+      std::vector<Color> colors(count);
+      for (size_t i = 0; i < count; i++)
+      {
+         indices[i] = random.Uniform(palette.m_Colors.size());
+         colors[i] = round % 5 == 0 ? palette.m_Colors[random.Uniform(palette.m_Colors.size())]
+            : Color(uint8_t(random.Uniform(256)), uint8_t(random.Uniform(256)), uint8_t(random.Uniform(256)));
+      }
+      palette.SetColors(indices.data(), colors.data(), count);
+
+      Palette full("");
+      full.m_Colors = palette.m_Colors;
+      full.Evaluate();
+      CHECK(palette.IsIncremental());
+      CHECK(BitwiseEqual(palette.m_Evaluation.m_MinDistance, full.m_Evaluation.m_MinDistance));
+      CHECK(BitwiseEqual(palette.m_Evaluation.m_MaxDistance, full.m_Evaluation.m_MaxDistance));
+      CHECK(BitwiseEqual(palette.m_Evaluation.m_ColorRepresentation, full.m_Evaluation.m_ColorRepresentation));
+      CHECK(Close(palette.m_Evaluation.m_AverageDistance, full.m_Evaluation.m_AverageDistance));
+      CHECK(Close(palette.m_Evaluation.m_TotalEvaluation, full.m_Evaluation.m_TotalEvaluation));
+   }
+}
+
+TEST(EvaluateAllTypesMatchesConvertAndEvaluate)
+{
+   // Empty and tiny palettes, the serial path, and the tiled path, which
+   // CIEDE2000 takes from 512 colors and the others from 2048
+   const std::pair<DistanceMetric, std::vector<size_t>> cases[] =
+   {
+      { DistanceMetric::RGB, { 0, 1, 2, 3, 255, 300, 2100 } },
+      { DistanceMetric::CIE76, { 0, 1, 2, 3, 255, 2100 } },
+      { DistanceMetric::CIE2000, { 0, 1, 2, 3, 255, 700 } },
+      { DistanceMetric::OKLAB, { 0, 1, 2, 3, 255, 2100 } },
+   };
+   for (const auto& [metric, sizes] : cases)
+   {
+      for (size_t size : sizes)
+      {
+         Palette palette = RandomPalette(size, size + 100);
+         palette.m_Metric = metric;
+         MultiTypeEvaluation evaluation;
+         palette.EvaluateAllTypes(evaluation);
+         for (size_t type = 0; type < BlindnessType::LAST; type++)
+         {
+            Palette converted("");
+            Converter::ConvertPalette(palette, static_cast<BlindnessType>(type), converted);
+            converted.m_Metric = metric;
+            converted.Evaluate();
+            CHECK(BitwiseEqual(evaluation.m_Types[type], converted.m_Evaluation));
+         }
+      }
+   }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Palette.h"
+
+#include <vector>
+
+namespace color
+{
+
+// Single GA steps for the tests and the benchmark, without RunGA's output
+struct GAAccess
+{
+   using Individual = PalettesGA::Individual;
+
+   static std::vector<Individual>& Population(PalettesGA& ga) { return ga.m_Palettes; }
+   static double RunGeneration(PalettesGA& ga, double mutationRate, double crossoverRate)
+   {
+      return ga.RunGeneration(mutationRate, crossoverRate);
+   }
+   static bool Crossover(const PalettesGA& ga, const Individual& parent1, const Individual& parent2,
+                         Individual& child, Random& random)
+   {
+      return ga.Crossover(parent1, parent2, child, random);
+   }
+   static void RunEpoch(PalettesIslands& islands, size_t epoch, size_t generations, double mutationRate,
+                        double crossoverRate)
+   {
+      islands.RunEpoch(epoch, generations, mutationRate, crossoverRate);
+   }
+};
+
+}
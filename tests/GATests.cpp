@@ -0,0 +1,120 @@
+#include "Test.h"
+#include "GAAccess.h"
+#include "Palette.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace color;
+
+// Every fitness and color of a population, for comparing runs bit for bit
+static std::vector<unsigned char> Snapshot(PalettesGA& ga)
+{
+   std::vector<unsigned char> bytes;
+   for (const GAAccess::Individual& individual : GAAccess::Population(ga))
+   {
+      const unsigned char* fitness = reinterpret_cast<const unsigned char*>(&individual.m_Fitness);
+      const unsigned char* colors = reinterpret_cast<const unsigned char*>(individual.m_Palette.m_Colors.data());
+      bytes.insert(bytes.end(), fitness, fitness + sizeof(double));
+      bytes.insert(bytes.end(), colors, colors + individual.m_Palette.m_Colors.size() * sizeof(Color));
+   }
+   return bytes;
+}
+
+// Islands on pools of 1, 3 and 8 threads end in the same state
+static void CheckIslandsThreadCountIndependence(MigrationTopology topology)
+{
+   const size_t threadCounts[] = { 1, 3, 8 };
+   std::vector<std::vector<unsigned char>> first;
+   for (size_t threads : threadCounts)
+   {
+      PalettesIslands islands(BlindnessType::DEUTERANOPIA, 4, 8, DistanceMetric::RGB, 17);
+      islands.SetParallelism(threads);
+      islands.SetMigration(topology, 2, 2);
+      for (size_t epoch = 0; epoch < 4; epoch++)
+      {
+         GAAccess::RunEpoch(islands, epoch, 2, 0.3, 0.5);
+      }
+
+      std::vector<std::vector<unsigned char>> snapshots;
+      for (size_t island = 0; island < islands.IslandCount(); island++)
+      {
+         snapshots.push_back(Snapshot(islands.GetIsland(island)));
+      }
+      if (first.empty())
+      {
+         first = snapshots;
+      }
+      else
+      {
+         CHECK(snapshots == first);
+      }
+   }
+}
+
+TEST(IslandsAreThreadCountIndependentRing)
+{
+   CheckIslandsThreadCountIndependence(MigrationTopology::RING);
+}
+
+TEST(IslandsAreThreadCountIndependentAllToAll)
+{
+   CheckIslandsThreadCountIndependence(MigrationTopology::ALL_TO_ALL);
+}
+
+// A seeded GA ends in the same state on one thread as on several, with
+// per-individual tasks or chunks of them. make builds a fresh, configured GA.
+template <typename Make>
+static void CheckGAThreadCountIndependence(Make make)
+{
+   const std::pair<size_t, size_t> pools[] = { { 1, 1 }, { 4, 1 }, { 8, 3 } };
+   std::vector<unsigned char> first;
+   for (const auto& pool : pools)
+   {
+      std::unique_ptr<PalettesGA> ga = make();
+      ga->SetParallelism(pool.first, pool.second);
+      for (size_t generation = 0; generation < 8; generation++)
+      {
+         GAAccess::RunGeneration(*ga, 0.3, 0.5);
+      }
+      std::vector<unsigned char> snapshot = Snapshot(*ga);
+      if (first.empty())
+      {
+         first = snapshot;
+      }
+      else
+      {
+         CHECK(snapshot == first);
+      }
+   }
+}
+
+TEST(GAIsThreadCountIndependentRgb)
+{
+   CheckGAThreadCountIndependence([]() {
+      return std::make_unique<PalettesGA>(BlindnessType::DEUTERANOPIA, 16, DistanceMetric::RGB, 5);
+   });
+}
+
+TEST(GAIsThreadCountIndependentMultiType)
+{
+   CheckGAThreadCountIndependence([]() {
+      std::vector<BlindnessType> types = { BlindnessType::PROTANOPIA, BlindnessType::TRITANOPIA };
+      auto ga = std::make_unique<PalettesGA>(types, 12, MultiTypeFitness::WEIGHTED, std::vector<double>{ 2.0, 1.0 },
+                                             DistanceMetric::OKLAB, 6);
+      ga->SetSelection(SelectionMethod::TOURNAMENT, 3);
+      ga->SetCrossover(CrossoverMethod::UNIFORM);
+      ga->SetMutation(MutationMethod::CHANNEL_SHIFT);
+      return ga;
+   });
+}
+
+TEST(GASeedsGiveDifferentRuns)
+{
+   PalettesGA a(BlindnessType::DEUTERANOPIA, 8, DistanceMetric::RGB, 1);
+   PalettesGA b(BlindnessType::DEUTERANOPIA, 8, DistanceMetric::RGB, 2);
+   GAAccess::RunGeneration(a, 0.3, 0.5);
+   GAAccess::RunGeneration(b, 0.3, 0.5);
+   CHECK(Snapshot(a) != Snapshot(b));
+}
@@ -0,0 +1,109 @@
+#include "Test.h"
+#include "Kernels.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace color;
+
+// Sizes 0 to 200 cover every SIMD width's main loop and tail. The inputs
+// start one byte into their buffers so no load is aligned by accident.
+static const size_t MAX_COLORS = 200;
+
+static std::vector<unsigned char> RandomBytes(size_t count, Random& random)
+{
+   std::vector<unsigned char> bytes(count);
+   for (unsigned char& byte : bytes)
+   {
+      byte = static_cast<unsigned char>(random.Uniform(256));
+   }
+   return bytes;
+}
+
+TEST(SelectColorsMatchesScalarLoop)
+{
+   Random random(21);
+   std::vector<unsigned char> first = RandomBytes(4 * MAX_COLORS + 1, random);
+   std::vector<unsigned char> second = RandomBytes(4 * MAX_COLORS + 1, random);
+   for (size_t colors = 0; colors <= MAX_COLORS; colors++)
+   {
+      std::vector<uint64_t> bits((colors + 63) / 64 + 1);
+      random.Fill(bits.data(), bits.size());
+      // Past the end the output has to stay untouched
+      std::vector<unsigned char> out(4 * colors + 9, 0xAB);
+      kernels::SelectColors(first.data() + 1, second.data() + 1, bits.data(), out.data() + 1, colors);
+      for (size_t i = 0; i < colors; i++)
+      {
+         const unsigned char* source = (bits[i / 64] >> (i % 64)) & 1 ? first.data() + 1 : second.data() + 1;
+         CHECK(std::memcmp(out.data() + 1 + 4 * i, source + 4 * i, 4) == 0);
+      }
+      CHECK(out[0] == 0xAB);
+      for (size_t i = 4 * colors + 1; i < out.size(); i++)
+      {
+         CHECK(out[i] == 0xAB);
+      }
+   }
+}
+
+TEST(BlendBytesMatchesScalarLoop)
+{
+   Random random(22);
+   std::vector<unsigned char> first = RandomBytes(4 * MAX_COLORS + 1, random);
+   std::vector<unsigned char> second = RandomBytes(4 * MAX_COLORS + 1, random);
+   // The ends of the weight range and a few between
+   const unsigned weights[] = { 0, 1, 127, 128, 129, 255, 256 };
+   for (size_t count = 0; count <= 4 * MAX_COLORS; count++)
+   {
+      for (unsigned weight : weights)
+      {
+         std::vector<unsigned char> out(count + 34, 0xAB);
+         kernels::BlendBytes(first.data() + 1, second.data() + 1, weight, out.data() + 1, count);
+         for (size_t i = 0; i < count; i++)
+         {
+            unsigned expected = (first[1 + i] * (256 - weight) + second[1 + i] * weight + 128) >> 8;
+            CHECK(out[1 + i] == expected);
+         }
+         CHECK(out[0] == 0xAB);
+         for (size_t i = count + 1; i < out.size(); i++)
+         {
+            CHECK(out[i] == 0xAB);
+         }
+      }
+   }
+}
+
+TEST(AddSaturatedMatchesClamp)
+{
+   Random random(23);
+   for (size_t count = 0; count <= 4 * MAX_COLORS; count++)
+   {
+      std::vector<unsigned char> bytes = RandomBytes(count + 34, random);
+      std::vector<unsigned char> original = bytes;
+      std::vector<signed char> deltas(count + 1);
+      for (signed char& delta : deltas)
+      {
+         delta = static_cast<signed char>(int(random.Uniform(256)) - 128);
+      }
+      // Both ends of each range, wherever they land in the vectors
+      if (count >= 4)
+      {
+         bytes[1] = 0; deltas[1] = -128;
+         bytes[2] = 255; deltas[2] = 127;
+         bytes[3] = 0; deltas[3] = 127;
+         bytes[4] = 255; deltas[4] = -128;
+         original = bytes;
+      }
+      kernels::AddSaturated(bytes.data() + 1, deltas.data() + 1, count);
+      for (size_t i = 0; i < count; i++)
+      {
+         CHECK(bytes[1 + i] == std::clamp(original[1 + i] + deltas[1 + i], 0, 255));
+      }
+      CHECK(bytes[0] == original[0]);
+      for (size_t i = count + 1; i < bytes.size(); i++)
+      {
+         CHECK(bytes[i] == original[i]);
+      }
+   }
+}
@@ -0,0 +1,93 @@
+#include "Test.h"
+#include "Perceptual.h"
+
+#include <cmath>
+
+using namespace color;
+
+// Sharma, Wu and Dalal, "The CIEDE2000 color-difference formula", test data
+// to four decimals: L1 a1 b1, L2 a2 b2, expected difference
+struct SharmaPair
+{
+   float m_First[3];
+   float m_Second[3];
+   double m_Difference;
+};
+static const SharmaPair SHARMA_PAIRS[] =
+{
+   { { 50.0000f, 2.6772f, -79.7751f }, { 50.0000f, 0.0000f, -82.7485f }, 2.0425 },
+   { { 50.0000f, 3.1571f, -77.2803f }, { 50.0000f, 0.0000f, -82.7485f }, 2.8615 },
+   { { 50.0000f, 2.8361f, -74.0200f }, { 50.0000f, 0.0000f, -82.7485f }, 3.4412 },
+   { { 50.0000f, -1.3802f, -84.2814f }, { 50.0000f, 0.0000f, -82.7485f }, 1.0000 },
+   { { 50.0000f, -1.1848f, -84.8006f }, { 50.0000f, 0.0000f, -82.7485f }, 1.0000 },
+   { { 50.0000f, -0.9009f, -85.5211f }, { 50.0000f, 0.0000f, -82.7485f }, 1.0000 },
+   // One color on the gray axis, where hue is undefined
+   { { 50.0000f, 0.0000f, 0.0000f }, { 50.0000f, -1.0000f, 2.0000f }, 2.3669 },
+   { { 50.0000f, -1.0000f, 2.0000f }, { 50.0000f, 0.0000f, 0.0000f }, 2.3669 },
+   // Hues about 180 degrees apart, on either side of the wrap
+   { { 50.0000f, 2.4900f, -0.0010f }, { 50.0000f, -2.4900f, 0.0009f }, 7.1792 },
+   { { 50.0000f, 2.4900f, -0.0010f }, { 50.0000f, -2.4900f, 0.0010f }, 7.1792 },
+   { { 50.0000f, 2.4900f, -0.0010f }, { 50.0000f, -2.4900f, 0.0011f }, 7.2195 },
+   { { 50.0000f, 2.4900f, -0.0010f }, { 50.0000f, -2.4900f, 0.0012f }, 7.2195 },
+   { { 50.0000f, -0.0010f, 2.4900f }, { 50.0000f, 0.0009f, -2.4900f }, 4.8045 },
+   { { 50.0000f, -0.0010f, 2.4900f }, { 50.0000f, 0.0010f, -2.4900f }, 4.8045 },
+   { { 50.0000f, -0.0010f, 2.4900f }, { 50.0000f, 0.0011f, -2.4900f }, 4.7461 },
+   { { 50.0000f, 2.5000f, 0.0000f }, { 50.0000f, 0.0000f, -2.5000f }, 4.3065 },
+   { { 50.0000f, 2.5000f, 0.0000f }, { 73.0000f, 25.0000f, -18.0000f }, 27.1492 },
+   { { 50.0000f, 2.5000f, 0.0000f }, { 61.0000f, -5.0000f, 29.0000f }, 22.8977 },
+   { { 50.0000f, 2.5000f, 0.0000f }, { 56.0000f, -27.0000f, -3.0000f }, 31.9030 },
+   { { 50.0000f, 2.5000f, 0.0000f }, { 58.0000f, 24.0000f, 15.0000f }, 19.4535 },
+   { { 50.0000f, 2.5000f, 0.0000f }, { 50.0000f, 3.1736f, 0.5854f }, 1.0000 },
+   { { 50.0000f, 2.5000f, 0.0000f }, { 50.0000f, 3.2972f, 0.0000f }, 1.0000 },
+   { { 50.0000f, 2.5000f, 0.0000f }, { 50.0000f, 1.8634f, 0.5757f }, 1.0000 },
+   { { 50.0000f, 2.5000f, 0.0000f }, { 50.0000f, 3.2592f, 0.3350f }, 1.0000 },
+   { { 60.2574f, -34.0099f, 36.2677f }, { 60.4626f, -34.1751f, 39.4387f }, 1.2644 },
+   { { 63.0109f, -31.0961f, -5.8663f }, { 62.8187f, -29.7946f, -4.0864f }, 1.2630 },
+   { { 61.2901f, 3.7196f, -5.3901f }, { 61.4292f, 2.2480f, -4.9620f }, 1.8731 },
+   { { 35.0831f, -44.1164f, 3.7933f }, { 35.0232f, -40.0716f, 1.5901f }, 1.8645 },
+   { { 22.7233f, 20.0904f, -46.6940f }, { 23.0331f, 14.9730f, -42.5619f }, 2.0373 },
+   { { 36.4612f, 47.8580f, 18.3852f }, { 36.2715f, 50.5065f, 21.2231f }, 1.4146 },
+   { { 90.8027f, -2.0831f, 1.4410f }, { 91.1528f, -1.6435f, 0.0447f }, 1.4441 },
+   { { 90.9257f, -0.5406f, -0.9208f }, { 88.6381f, -0.8985f, -0.7239f }, 1.5381 },
+   { { 6.7747f, -0.2908f, -2.4247f }, { 5.8714f, -0.0985f, -2.2286f }, 0.6377 },
+   { { 2.0776f, 0.0795f, -1.1350f }, { 0.9033f, -0.0636f, -0.5514f }, 0.9082 },
+};
+
+// The table is rounded to four decimals
+static const double SHARMA_TOLERANCE = 1e-4;
+
+TEST(DeltaE2000MatchesSharmaPairs)
+{
+   for (const SharmaPair& pair : SHARMA_PAIRS)
+   {
+      const float* first = pair.m_First;
+      const float* second = pair.m_Second;
+      double forward = perceptual::DeltaE2000(first[0], first[1], first[2], second[0], second[1], second[2]);
+      double backward = perceptual::DeltaE2000(second[0], second[1], second[2], first[0], first[1], first[2]);
+      CHECK(fabs(forward - pair.m_Difference) <= SHARMA_TOLERANCE);
+      CHECK(fabs(backward - pair.m_Difference) <= SHARMA_TOLERANCE);
+   }
+}
+
+TEST(DeltaE2000BatchMatchesSingle)
+{
+   // Every pair's second color in one batch against each first color
+   const size_t count = sizeof(SHARMA_PAIRS) / sizeof(SHARMA_PAIRS[0]);
+   float L[count], a[count], b[count];
+   for (size_t i = 0; i < count; i++)
+   {
+      L[i] = SHARMA_PAIRS[i].m_Second[0];
+      a[i] = SHARMA_PAIRS[i].m_Second[1];
+      b[i] = SHARMA_PAIRS[i].m_Second[2];
+   }
+   double distances[count];
+   for (const SharmaPair& pair : SHARMA_PAIRS)
+   {
+      const float* first = pair.m_First;
+      perceptual::DeltaE2000(first[0], first[1], first[2], L, a, b, count, distances);
+      for (size_t i = 0; i < count; i++)
+      {
+         CHECK(distances[i] == perceptual::DeltaE2000(first[0], first[1], first[2], L[i], a[i], b[i]));
+      }
+   }
+}
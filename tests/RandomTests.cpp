@@ -0,0 +1,70 @@
+#include "Test.h"
+#include "Random.h"
+
+#include <vector>
+
+using namespace color;
+
+TEST(RandomUniformStaysBelowBound)
+{
+   // Powers of two, the smallest bounds, and ones with large rejection
+   // thresholds near 2^31 and 2^32
+   const uint32_t bounds[] = { 1, 2, 3, 7, 10, 255, 256, 257, 1000, 65537, 0x80000001u, 0xFFFFFFFFu };
+   Random random(31);
+   for (uint32_t bound : bounds)
+   {
+      for (size_t i = 0; i < 20000; i++)
+      {
+         CHECK(random.Uniform(bound) < bound);
+      }
+   }
+}
+
+TEST(RandomUniformCoversSmallBoundsEvenly)
+{
+   Random random(32);
+   const uint32_t bounds[] = { 2, 3, 7, 10, 256, 257 };
+   for (uint32_t bound : bounds)
+   {
+      const size_t DRAWS_PER_VALUE = 2000;
+      std::vector<size_t> counts(bound, 0);
+      for (size_t i = 0; i < DRAWS_PER_VALUE * bound; i++)
+      {
+         counts[random.Uniform(bound)]++;
+      }
+      // Binomial with a standard deviation of about 45, so six of them
+      // only fail on a broken generator
+      for (size_t count : counts)
+      {
+         CHECK(count > DRAWS_PER_VALUE - 270 && count < DRAWS_PER_VALUE + 270);
+      }
+   }
+}
+
+TEST(RandomUniformUnbiasedNearHalfRange)
+{
+   // With a bound of 3 * 2^30 + 1, reducing 32-bit draws modulo the bound
+   // would put about 62% of the values in the lower half
+   Random random(33);
+   const uint32_t bound = 0xC0000001u;
+   const size_t DRAWS = 200000;
+   size_t low = 0;
+   for (size_t i = 0; i < DRAWS; i++)
+   {
+      low += random.Uniform(bound) < bound / 2;
+   }
+   CHECK(low > DRAWS / 2 - 2000 && low < DRAWS / 2 + 2000);
+}
+
+TEST(RandomStreamsAreReproducible)
+{
+   Random a(7, 3), b(7, 3), c(7, 4);
+   bool differs = false;
+   for (size_t i = 0; i < 1000; i++)
+   {
+      uint64_t value = a.Next();
+      CHECK(value == b.Next());
+      differs = differs || value != c.Next();
+   }
+   CHECK(differs);
+}
@@ -0,0 +1,123 @@
+#include "Test.h"
+#include "SimulationLUT.h"
+#include "Palette.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+using namespace color;
+
+static std::string TempPath(const std::string& name)
+{
+   return (std::filesystem::temp_directory_path() / name).string();
+}
+
+TEST(SimulationLUTCacheFileNameHasGridSize)
+{
+   CHECK(SimulationLUT::CacheFileName("lut.bin", 33) == "lut.33.bin");
+   CHECK(SimulationLUT::CacheFileName("cache/lut", 65) == "cache/lut.65");
+   CHECK(SimulationLUT::CacheFileName("a.dir/lut", 17) == "a.dir/lut.17");
+   CHECK(SimulationLUT::CacheFileName(".lut", 9) == ".lut.9");
+}
+
+TEST(SimulationLUTTypesPastLastConvertAsNormal)
+{
+   SimulationLUT lut(9);
+   for (size_t value = 0; value < 256; value += 15)
+   {
+      Color color(value, 255 - value, (value * 7) & 0xFF);
+      Color normal = lut.Convert(color, BlindnessType::NORMAL);
+      CHECK(lut.Convert(color, BlindnessType::LAST) == normal);
+      CHECK(lut.Convert(color, static_cast<BlindnessType>(BlindnessType::LAST + 3)) == normal);
+   }
+}
+
+TEST(SimulationLUTStaysCloseToExactPath)
+{
+   SimulationLUT lut(33);
+   for (size_t type = 0; type < BlindnessType::LAST; type++)
+   {
+      CHECK(lut.MaxError(static_cast<BlindnessType>(type), 15) <= 2);
+   }
+}
+
+TEST(SimulationLUTSaveAndMapRoundTrip)
+{
+   const std::string cachePath = TempPath("color-lut-test.bin");
+   const std::string path9 = SimulationLUT::CacheFileName(cachePath, 9);
+   const std::string path17 = SimulationLUT::CacheFileName(cachePath, 17);
+   std::remove(path9.c_str());
+   std::remove(path17.c_str());
+
+   SimulationLUT built(9, cachePath);
+   CHECK(!built.IsMapped());
+   SimulationLUT mapped(9, cachePath);
+   CHECK(mapped.IsMapped());
+
+   // Another grid size keeps its own file instead of rejecting this one
+   SimulationLUT other(17, cachePath);
+   CHECK(!other.IsMapped());
+   CHECK(SimulationLUT(9, cachePath).IsMapped());
+
+   // A file made for one grid size is rejected by another
+   SimulationLUT loader(17);
+   CHECK(!loader.Load(path9));
+   CHECK(loader.Load(path17));
+
+   for (size_t value = 0; value < 256; value += 5)
+   {
+      Color color(value, (value * 3) & 0xFF, 255 - value);
+      for (size_t type = 0; type < BlindnessType::LAST; type++)
+      {
+         BlindnessType blindness = static_cast<BlindnessType>(type);
+         CHECK(mapped.Convert(color, blindness) == built.Convert(color, blindness));
+      }
+   }
+
+   // Saving over a mapped file replaces it without disturbing the mapping
+   CHECK(built.Save(path9));
+   CHECK(mapped.Convert(Color(10, 200, 30), BlindnessType::PROTANOPIA) ==
+         built.Convert(Color(10, 200, 30), BlindnessType::PROTANOPIA));
+
+   std::remove(path9.c_str());
+   std::remove(path17.c_str());
+}
+
+TEST(ConverterRoutesThroughSimulationLUT)
+{
+   const Color colors[] = { Color(0, 0, 0), Color(255, 255, 255), Color(12, 200, 77), Color(250, 3, 128) };
+   const size_t count = sizeof(colors) / sizeof(colors[0]);
+
+   const SimulationLUT& lut = Converter::EnableSimulationLUT(17);
+   CHECK(Converter::GetSimulationLUT() == &lut);
+   for (size_t type = 0; type <= BlindnessType::LAST; type++)
+   {
+      BlindnessType blindness = static_cast<BlindnessType>(type);
+      Color batch[count], all[BlindnessType::LAST][count];
+      Color* outputs[BlindnessType::LAST];
+      for (size_t i = 0; i < BlindnessType::LAST; i++) { outputs[i] = all[i]; }
+      Converter::ConvertColors(colors, count, blindness, batch);
+      Converter::GetConvertColorsFunction(blindness)(colors, count, batch);
+      Converter::ConvertAllTypes(colors, count, outputs);
+      for (size_t i = 0; i < count; i++)
+      {
+         Color expected = lut.Convert(colors[i], blindness);
+         CHECK(Converter::ConvertColor(colors[i], blindness) == expected);
+         CHECK(Converter::GetConvertFunction(blindness)(colors[i]) == expected);
+         CHECK(batch[i] == expected);
+         if (type < BlindnessType::LAST) { CHECK(all[type][i] == expected); }
+      }
+   }
+
+   Converter::DisableSimulationLUT();
+   CHECK(Converter::GetSimulationLUT() == nullptr);
+   for (size_t type = 0; type < BlindnessType::LAST; type++)
+   {
+      BlindnessType blindness = static_cast<BlindnessType>(type);
+      for (size_t i = 0; i < count; i++)
+      {
+         CHECK(Converter::ConvertColor(colors[i], blindness) == Converter::ConvertColorExact(colors[i], blindness));
+      }
+   }
+}
@@ -0,0 +1,107 @@
+#include "Test.h"
+#include "Srgb.h"
+#include "Kernels.h"
+#include "Palette.h"
+
+#include <cmath>
+#include <limits>
+
+using namespace color;
+
+// What Converter::LinearToStandard computed before the tables, for 0-1 input
+static size_t ReferenceEncode(double linear)
+{
+   return static_cast<size_t>(round(SrgbTables::EncodeCurve(linear)));
+}
+
+TEST(SrgbDecodeMatchesCurve)
+{
+   const SrgbTables& tables = SrgbTables::Get();
+   for (size_t channel = 0; channel < 256; channel++)
+   {
+      CHECK(tables.m_Decode[channel] == SrgbTables::DecodeCurve(double(channel)));
+   }
+}
+
+TEST(SrgbEncodeMatchesReferenceOnDecodedChannels)
+{
+   const SrgbTables& tables = SrgbTables::Get();
+   for (size_t channel = 0; channel < 256; channel++)
+   {
+      double linear = tables.m_Decode[channel];
+      CHECK(tables.Encode(linear) == ReferenceEncode(linear));
+   }
+}
+
+TEST(SrgbEncodeMatchesReferenceOnSimulatedColors)
+{
+   // Every linear value a simulation matrix makes from the decoded channels,
+   // over a lattice of input colors, through the scalar and the batch path
+   const SrgbTables& tables = SrgbTables::Get();
+   const size_t STEP = 5;
+   std::vector<double> linear;
+   std::vector<size_t> expected;
+   for (size_t type = BlindnessType::DEUTERANOPIA; type < BlindnessType::LAST; type++)
+   {
+      const double* matrix = Converter::SimulationMatrix(static_cast<BlindnessType>(type));
+      for (size_t r = 0; r < 256; r += STEP)
+      {
+         for (size_t g = 0; g < 256; g += STEP)
+         {
+            for (size_t b = 0; b < 256; b += STEP)
+            {
+               double converted[3];
+               Converter::ApplyMatrix(matrix, tables.m_Decode[r], tables.m_Decode[g], tables.m_Decode[b],
+                                      &converted[0], &converted[1], &converted[2]);
+               for (double value : converted)
+               {
+                  if (value >= 0.0 && value <= 1.0)
+                  {
+                     linear.push_back(value);
+                     expected.push_back(ReferenceEncode(value));
+                  }
+               }
+            }
+         }
+      }
+   }
+
+   std::vector<unsigned char> encoded(linear.size());
+   kernels::Encode(linear.data(), encoded.data(), linear.size());
+   size_t mismatches = 0;
+   for (size_t i = 0; i < linear.size(); i++)
+   {
+      mismatches += tables.Encode(linear[i]) != expected[i] || encoded[i] != expected[i];
+   }
+   CHECK(!linear.empty());
+   CHECK(mismatches == 0);
+}
+
+TEST(SrgbEncodeMatchesReferenceOnDenseSweep)
+{
+   const SrgbTables& tables = SrgbTables::Get();
+   const size_t STEPS = 1 << 20;
+   size_t mismatches = 0;
+   for (size_t i = 0; i <= STEPS; i++)
+   {
+      double linear = double(i) / STEPS;
+      mismatches += tables.Encode(linear) != ReferenceEncode(linear);
+   }
+   CHECK(mismatches == 0);
+}
+
+TEST(SrgbEncodeClampsOutOfRange)
+{
+   const SrgbTables& tables = SrgbTables::Get();
+   CHECK(tables.Encode(-0.5) == 0);
+   CHECK(tables.Encode(-std::numeric_limits<double>::infinity()) == 0);
+   CHECK(tables.Encode(std::numeric_limits<double>::quiet_NaN()) == 0);
+   CHECK(tables.Encode(1.0) == 255);
+   CHECK(tables.Encode(1.5) == 255);
+   CHECK(tables.Encode(std::numeric_limits<double>::infinity()) == 255);
+
+   double values[5] = { -1.0, 2.0, std::numeric_limits<double>::quiet_NaN(), 0.0, 1.0 };
+   unsigned char encoded[5];
+   kernels::Encode(values, encoded, 5);
+   CHECK(encoded[0] == 0 && encoded[1] == 255 && encoded[2] == 0 && encoded[3] == 0 && encoded[4] == 255);
+}
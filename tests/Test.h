@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace test
+{
+
+using TestFunction = void (*)();
+
+struct TestCase
+{
+   const char* m_Name;
+   TestFunction m_Function;
+};
+
+// Every TEST in the executable, in link order
+std::vector<TestCase>& Registry();
+// Records a failed CHECK, the test keeps running
+void Fail(const char* file, int line, const std::string& message);
+
+struct Registrar
+{
+   Registrar(const char* name, TestFunction function) { Registry().push_back({ name, function }); }
+};
+
+}
+
+#define TEST(name) \
+   static void name(); \
+   static test::Registrar name##Registrar(#name, name); \
+   static void name()
+
+#define CHECK(condition) \
+   do { if (!(condition)) { test::Fail(__FILE__, __LINE__, #condition); } } while (0)
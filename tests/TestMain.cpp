@@ -0,0 +1,42 @@
+#include "Test.h"
+
+#include <iostream>
+
+namespace test {
+
+static size_t s_Failures = 0;
+
+std::vector<TestCase>& Registry()
+{
+   static std::vector<TestCase> registry;
+   return registry;
+}
+void Fail(const char* file, int line, const std::string& message)
+{
+   std::cout << file << ":" << line << ": CHECK(" << message << ") failed" << std::endl;
+   s_Failures++;
+}
+
+}
+
+// Runs every test, or only those whose name contains the first argument
+int main(int argc, char* argv[])
+{
+   std::string filter = argc > 1 ? argv[1] : "";
+   size_t failedTests = 0, ranTests = 0;
+   for (const test::TestCase& testCase : test::Registry())
+   {
+      if (std::string(testCase.m_Name).find(filter) == std::string::npos)
+      {
+         continue;
+      }
+      size_t failuresBefore = test::s_Failures;
+      testCase.m_Function();
+      bool passed = test::s_Failures == failuresBefore;
+      std::cout << (passed ? "[pass] " : "[FAIL] ") << testCase.m_Name << std::endl;
+      failedTests += passed ? 0 : 1;
+      ranTests++;
+   }
+   std::cout << ranTests - failedTests << "/" << ranTests << " tests passed" << std::endl;
+   return failedTests == 0 ? 0 : 1;
+}